@@ -0,0 +1,408 @@
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include "archive.h"
+#include "helpers.h"
+
+namespace compression {
+
+const size_t kMaxDictionaryBytes = 65535;
+
+namespace {
+
+// Dictionary id, number of blocks, uncompressed size and the CRC32 of all of it.
+const size_t kArchiveHeaderBytes = 4 * 4;
+// Bit count and CRC32 in front of every serialized block, see EncodedDataBlock::Serialize.
+const size_t kBlockFrameHeaderBytes = 4 + 4;
+
+// LZ4 block format limits: matches are at least 4 bytes, none starts within the last 12 bytes
+// and the last 5 bytes are always literals. Offsets are 16 bits.
+const size_t kMinMatch = 4;
+const size_t kMatchLimit = 12;
+const size_t kLastLiterals = 5;
+const size_t kMaxOffset = 65535;
+const int kHashBits = 16;
+// Bytes past the output the decompressor may scribble on when copying 8 bytes at a time.
+const size_t kArenaSlack = 8;
+
+// Fragment length the dictionary trainer counts and the length of the pieces it picks.
+const size_t kTrainKmer = 6;
+const size_t kTrainSegment = 64;
+const int kTrainHashBits = 20;
+
+std::uint32_t Load32(const std::uint8_t* p) {
+    std::uint32_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+std::uint32_t ReadLE32(const std::uint8_t* p) {
+    return std::uint32_t(p[0]) | std::uint32_t(p[1]) << 8 | std::uint32_t(p[2]) << 16 |
+        std::uint32_t(p[3]) << 24;
+}
+
+void WriteLE32(std::uint8_t* p, std::uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        p[i] = (value >> (8 * i)) & 0xFF;
+    }
+}
+
+std::uint32_t Hash4(const std::uint8_t* p) {
+    return (Load32(p) * 2654435761u) >> (32 - kHashBits);
+}
+
+std::uint32_t HashKmer(const std::uint8_t* p) {
+    std::uint64_t value = 0;
+    std::memcpy(&value, p, kTrainKmer);
+    return (value * 0x9E3779B97F4A7C15ull) >> (64 - kTrainHashBits);
+}
+
+void PutLength(std::vector<std::uint8_t>& out, size_t length) {
+    while (length >= 255) {
+        out.push_back(255);
+        length -= 255;
+    }
+    out.push_back(length);
+}
+
+void PutSequence(std::vector<std::uint8_t>& out, const std::uint8_t* literals, size_t num_literals,
+    size_t offset, size_t match_length) {
+    size_t match_code = match_length ? match_length - kMinMatch : 0;
+    out.push_back(std::min<size_t>(num_literals, 15) << 4 | std::min<size_t>(match_code, 15));
+    if (num_literals >= 15) {
+        PutLength(out, num_literals - 15);
+    }
+    out.insert(out.end(), literals, literals + num_literals);
+    if (!match_length) {
+        return;
+    }
+    out.push_back(offset & 0xFF);
+    out.push_back(offset >> 8);
+    if (match_code >= 15) {
+        PutLength(out, match_code - 15);
+    }
+}
+
+// Compresses src[begin, src.size()), the bytes before begin are the history matches can refer to.
+void Compress(const std::vector<std::uint8_t>& src, size_t begin, std::vector<std::uint8_t>& out) {
+    const std::uint8_t* base = src.data();
+    size_t end = src.size();
+    std::vector<std::uint32_t> table(1 << kHashBits, 0);
+    // Positions are stored plus one, 0 means empty.
+    for (size_t pos = begin > kMaxOffset ? begin - kMaxOffset : 0; pos + kMinMatch <= begin; pos++) {
+        table[Hash4(base + pos)] = pos + 1;
+    }
+
+    size_t anchor = begin;
+    size_t pos = begin;
+    size_t match_end_limit = end >= kLastLiterals ? end - kLastLiterals : 0;
+    while (end >= kMatchLimit && pos + kMatchLimit <= end) {
+        std::uint32_t hash = Hash4(base + pos);
+        size_t candidate = table[hash];
+        table[hash] = pos + 1;
+        if (!candidate || pos - (candidate - 1) > kMaxOffset ||
+            Load32(base + candidate - 1) != Load32(base + pos)) {
+            // Speeds up through data without matches, like noisy values.
+            pos += 1 + ((pos - anchor) >> 6);
+            continue;
+        }
+        size_t ref = candidate - 1;
+        size_t length = kMinMatch;
+        while (pos + length < match_end_limit && base[ref + length] == base[pos + length]) {
+            length++;
+        }
+        while (pos > anchor && ref > 0 && base[pos - 1] == base[ref - 1]) {
+            pos--;
+            ref--;
+            length++;
+        }
+        PutSequence(out, base + anchor, pos - anchor, pos - ref, length);
+        pos += length;
+        anchor = pos;
+        if (pos >= 2 && pos + kMinMatch <= end) {
+            table[Hash4(base + pos - 2)] = pos - 1;
+        }
+    }
+    PutSequence(out, base + anchor, end - anchor, 0, 0);
+}
+
+size_t GetLength(const std::uint8_t*& in, const std::uint8_t* in_end) {
+    size_t length = 0;
+    std::uint8_t byte;
+    do {
+        if (in == in_end) {
+            ThrowParsingError("archive ends within a length");
+        }
+        byte = *in++;
+        length += byte;
+    } while (byte == 255);
+    return length;
+}
+
+// Decompresses into arena[begin, end), matches can reach back to the start of the arena, which
+// has kArenaSlack spare bytes after end.
+void DecompressInto(const std::uint8_t* in, const std::uint8_t* in_end, std::uint8_t* arena,
+    size_t begin, size_t end) {
+    std::uint8_t* out = arena + begin;
+    std::uint8_t* out_end = arena + end;
+    while (true) {
+        if (in == in_end) {
+            ThrowParsingError("archive ends within a sequence");
+        }
+        std::uint8_t token = *in++;
+        size_t num_literals = token >> 4;
+        if (num_literals == 15) {
+            num_literals += GetLength(in, in_end);
+        }
+        if (num_literals > size_t(in_end - in) || num_literals > size_t(out_end - out)) {
+            ThrowParsingError("archive literals out of bounds");
+        }
+        std::memcpy(out, in, num_literals);
+        in += num_literals;
+        out += num_literals;
+        if (in == in_end) {
+            break;
+        }
+
+        if (in_end - in < 2) {
+            ThrowParsingError("archive ends within an offset");
+        }
+        size_t offset = in[0] | size_t(in[1]) << 8;
+        in += 2;
+        size_t length = (token & 15) + kMinMatch;
+        if ((token & 15) == 15) {
+            length += GetLength(in, in_end);
+        }
+        if (!offset || offset > size_t(out - arena) || length > size_t(out_end - out)) {
+            ThrowParsingError("archive match out of bounds");
+        }
+        const std::uint8_t* ref = out - offset;
+        if (offset >= 8) {
+            // The slack after the output allows overshooting by up to 7 bytes.
+            for (size_t i = 0; i < length; i += 8) {
+                std::memcpy(out + i, ref + i, 8);
+            }
+        } else {
+            for (size_t i = 0; i < length; i++) {
+                out[i] = ref[i];
+            }
+        }
+        out += length;
+    }
+    if (out != out_end) {
+        ThrowParsingError("archive decompressed to " + std::to_string(out - arena - begin) +
+            " bytes instead of " + std::to_string(end - begin));
+    }
+}
+
+} // namespace
+
+ArchiveDictionary TrainDictionary(const std::vector<const EncodedDataBlock*>& samples, size_t max_bytes) {
+    max_bytes = std::min(max_bytes, kMaxDictionaryBytes);
+    std::vector<std::uint8_t> data;
+    // Where the k-mers starting at a position still lie within its sample.
+    std::vector<bool> valid;
+    for (auto sample : samples) {
+        auto frame = sample->Load()->Serialize();
+        data.insert(data.end(), frame.begin(), frame.end());
+        for (size_t i = 0; i < frame.size(); i++) {
+            valid.push_back(i + kTrainKmer <= frame.size());
+        }
+    }
+
+    // In how many samples every k-mer appears, the ones seen in just one sample don't count.
+    std::vector<std::uint32_t> frequency(1 << kTrainHashBits, 0);
+    std::vector<std::uint32_t> last_sample(1 << kTrainHashBits, 0);
+    std::vector<std::uint32_t> hashes(data.size(), 0);
+    std::uint32_t sample = 0;
+    for (size_t pos = 0; pos < data.size(); pos++) {
+        if (pos == 0 || (!valid[pos - 1] && valid[pos])) {
+            sample++;
+        }
+        if (!valid[pos]) {
+            continue;
+        }
+        hashes[pos] = HashKmer(data.data() + pos);
+        if (last_sample[hashes[pos]] != sample) {
+            last_sample[hashes[pos]] = sample;
+            frequency[hashes[pos]]++;
+        }
+    }
+    auto score = [&](size_t pos) -> std::uint64_t {
+        return valid[pos] && frequency[hashes[pos]] > 1 ? frequency[hashes[pos]] : 0;
+    };
+
+    // Like the COVER algorithm: the samples are split into an epoch per segment of the dictionary
+    // and every epoch contributes its best scoring segment. The k-mers taken don't score again.
+    ArchiveDictionary dictionary;
+    size_t num_segments = std::max<size_t>(1, max_bytes / kTrainSegment);
+    size_t epoch = std::max(kTrainSegment, data.size() / num_segments);
+    for (size_t from = 0; from + kTrainSegment <= data.size() &&
+        dictionary.bytes.size() + kTrainSegment <= max_bytes; from += epoch) {
+        size_t to = std::min(from + epoch, data.size());
+        std::uint64_t window = 0;
+        for (size_t pos = from; pos < from + kTrainSegment; pos++) {
+            window += score(pos);
+        }
+        std::uint64_t best = window;
+        size_t best_from = from;
+        for (size_t pos = from + kTrainSegment; pos < to; pos++) {
+            window += score(pos);
+            window -= score(pos - kTrainSegment);
+            if (window > best) {
+                best = window;
+                best_from = pos + 1 - kTrainSegment;
+            }
+        }
+        if (!best) {
+            continue;
+        }
+        dictionary.bytes.insert(dictionary.bytes.end(), data.begin() + best_from,
+            data.begin() + best_from + kTrainSegment);
+        for (size_t pos = best_from; pos < best_from + kTrainSegment; pos++) {
+            if (valid[pos]) {
+                frequency[hashes[pos]] = 0;
+            }
+        }
+    }
+    if (!dictionary.bytes.empty()) {
+        std::uint32_t crc = Crc32(dictionary.bytes.data(), dictionary.bytes.size());
+        dictionary.id = crc ? crc : 1;
+    }
+    return dictionary;
+}
+
+std::vector<std::uint8_t> ArchiveBlocks(const std::vector<const EncodedDataBlock*>& blocks,
+    const ArchiveDictionary* dictionary) {
+    std::vector<std::uint8_t> src;
+    std::uint32_t dictionary_id = 0;
+    if (dictionary && !dictionary->bytes.empty()) {
+        if (dictionary->bytes.size() > kMaxDictionaryBytes) {
+            throw std::invalid_argument("archive dictionary longer than " +
+                std::to_string(kMaxDictionaryBytes) + " bytes");
+        }
+        src = dictionary->bytes;
+        dictionary_id = dictionary->id;
+    }
+    size_t begin = src.size();
+    for (auto block : blocks) {
+        auto frame = block->Load()->Serialize();
+        src.insert(src.end(), frame.begin(), frame.end());
+    }
+
+    std::vector<std::uint8_t> archive(kArchiveHeaderBytes);
+    WriteLE32(&archive[0], dictionary_id);
+    WriteLE32(&archive[4], blocks.size());
+    WriteLE32(&archive[8], src.size() - begin);
+    Compress(src, begin, archive);
+    if (archive.size() - kArchiveHeaderBytes >= src.size() - begin) {
+        // Stored as is, a payload as long as the blocks can't be compressed otherwise.
+        archive.resize(kArchiveHeaderBytes);
+        archive.insert(archive.end(), src.begin() + begin, src.end());
+    }
+    std::uint32_t crc = Crc32(archive.data(), 12);
+    crc = Crc32(archive.data() + kArchiveHeaderBytes, archive.size() - kArchiveHeaderBytes, crc);
+    WriteLE32(&archive[12], crc);
+    return archive;
+}
+
+void ArchiveReader::AddDictionary(const ArchiveDictionary& dictionary) {
+    if (dictionary.bytes.size() > kMaxDictionaryBytes) {
+        throw std::invalid_argument("archive dictionary longer than " +
+            std::to_string(kMaxDictionaryBytes) + " bytes");
+    }
+    dictionaries_[dictionary.id] = dictionary;
+    if (arena_dictionary_ == dictionary.id) {
+        // Copied in again by the next archive that needs it.
+        arena_dictionary_ = 0;
+        arena_begin_ = 0;
+    }
+}
+
+std::uint32_t ArchiveReader::Decompress(const std::uint8_t* archive, size_t size) {
+    if (size < kArchiveHeaderBytes) {
+        ThrowParsingError("archive shorter than its header");
+    }
+    std::uint32_t dictionary_id = ReadLE32(archive);
+    std::uint32_t num_blocks = ReadLE32(archive + 4);
+    std::uint32_t raw_size = ReadLE32(archive + 8);
+    std::uint32_t crc = Crc32(archive, 12);
+    if (Crc32(archive + kArchiveHeaderBytes, size - kArchiveHeaderBytes, crc) != ReadLE32(archive + 12)) {
+        ThrowParsingError("archive checksum mismatch");
+    }
+    // Every compressed byte expands to at most 255 ones, more would be a bogus header.
+    if (raw_size > 255 * (size - kArchiveHeaderBytes)) {
+        ThrowParsingError("archive can't expand to " + std::to_string(raw_size) + " bytes");
+    }
+
+    if (dictionary_id != arena_dictionary_) {
+        arena_begin_ = 0;
+        if (dictionary_id) {
+            auto it = dictionaries_.find(dictionary_id);
+            if (it == dictionaries_.end()) {
+                ThrowParsingError("archive needs the unknown dictionary " + std::to_string(dictionary_id));
+            }
+            arena_begin_ = it->second.bytes.size();
+            if (arena_.size() < arena_begin_) {
+                arena_.resize(arena_begin_);
+            }
+            std::copy(it->second.bytes.begin(), it->second.bytes.end(), arena_.begin());
+        }
+        arena_dictionary_ = dictionary_id;
+    }
+    arena_end_ = arena_begin_ + raw_size;
+    if (arena_.size() < arena_end_ + kArenaSlack) {
+        arena_.resize(arena_end_ + kArenaSlack);
+    }
+    if (size - kArchiveHeaderBytes == raw_size) {
+        std::copy(archive + kArchiveHeaderBytes, archive + size, arena_.begin() + arena_begin_);
+    } else {
+        DecompressInto(archive + kArchiveHeaderBytes, archive + size, arena_.data(), arena_begin_, arena_end_);
+    }
+    return num_blocks;
+}
+
+template <typename F>
+void ArchiveReader::ForEachFrame(std::uint32_t num_blocks, F f) {
+    size_t pos = arena_begin_;
+    for (std::uint32_t i = 0; i < num_blocks; i++) {
+        if (arena_end_ - pos < kBlockFrameHeaderBytes) {
+            ThrowParsingError("archive ends within block " + std::to_string(i));
+        }
+        std::uint64_t size_bits = ReadLE32(&arena_[pos]);
+        size_t frame_size = kBlockFrameHeaderBytes + (size_bits + 7) / 8;
+        if (arena_end_ - pos < frame_size) {
+            ThrowParsingError("archive ends within block " + std::to_string(i));
+        }
+        f(&arena_[pos], frame_size);
+        pos += frame_size;
+    }
+    if (pos != arena_end_) {
+        ThrowParsingError("archive has data after its last block");
+    }
+}
+
+std::vector<std::unique_ptr<EncodedDataBlock>> ArchiveReader::Blocks(const std::uint8_t* archive, size_t size) {
+    std::vector<std::unique_ptr<EncodedDataBlock>> blocks;
+    ForEachFrame(Decompress(archive, size), [&blocks](const std::uint8_t* frame, size_t frame_size) {
+        blocks.emplace_back(EncodedDataBlock::Deserialize(frame, frame_size));
+    });
+    return blocks;
+}
+
+std::vector<std::pair<TSType, ValType>> ArchiveReader::Decode(const std::uint8_t* archive, size_t size) {
+    std::vector<std::pair<TSType, ValType>> output;
+    Decode(archive, size, output);
+    return output;
+}
+
+void ArchiveReader::Decode(const std::uint8_t* archive, size_t size,
+    std::vector<std::pair<TSType, ValType>>& output) {
+    ForEachFrame(Decompress(archive, size), [&output](const std::uint8_t* frame, size_t frame_size) {
+        std::unique_ptr<EncodedDataBlock> block(EncodedDataBlock::Deserialize(frame, frame_size));
+        auto points = block->Decode();
+        output.insert(output.end(), points.begin(), points.end());
+    });
+}
+
+} // namespace compression
@@ -0,0 +1,74 @@
+#ifndef COMPRESSION_ARCHIVE_H
+#define COMPRESSION_ARCHIVE_H
+
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <cinttypes>
+#include "common.h"
+#include "compression.h"
+
+namespace compression {
+
+// Shared content of the blocks of a series family, e.g. all the cpu counters of a fleet. Matches
+// against it cover the redundancy a single archive doesn't have enough data to find on its own.
+struct ArchiveDictionary {
+    // Derived from the content, 0 stands for no dictionary.
+    std::uint32_t id = 0;
+    std::vector<std::uint8_t> bytes;
+};
+
+// The longest dictionary that matches can still reach into.
+extern const size_t kMaxDictionaryBytes;
+
+// Picks the fragments shared by most of the sample blocks, up to max_bytes of them. Like
+// ArchiveBlocks, cold blocks are loaded from their storage.
+ArchiveDictionary TrainDictionary(const std::vector<const EncodedDataBlock*>& samples,
+    size_t max_bytes = 16 << 10);
+
+// Second stage compression of sealed blocks which are rarely read anymore.
+//
+// The Serialize frames of the blocks are concatenated and compressed with a bundled LZ4 style
+// codec (same block format: literal runs and 16 bit back references, no entropy coding), with
+// the dictionary as the history before the first byte. The archive starts with a header holding
+// the dictionary id, the number of blocks, the uncompressed size and a CRC32 over all of it.
+// Blocks that don't get any smaller, like noisy values, are stored uncompressed. Cold blocks
+// are loaded from their storage first.
+std::vector<std::uint8_t> ArchiveBlocks(const std::vector<const EncodedDataBlock*>& blocks,
+    const ArchiveDictionary* dictionary = nullptr);
+
+// Opens archives made with any of the added dictionaries. The archive is decompressed into a
+// scratch arena which is kept between calls, so reading many archives allocates only for the
+// output. Not safe to use from several threads, every reader has its own arena.
+class ArchiveReader {
+
+public:
+    ArchiveReader() = default;
+
+    void AddDictionary(const ArchiveDictionary& dictionary);
+
+    // Throw ParsingError if the archive is corrupted or its dictionary wasn't added.
+    std::vector<std::unique_ptr<EncodedDataBlock>> Blocks(const std::uint8_t* archive, size_t size);
+    // All the points of the blocks, in the order the blocks were archived.
+    std::vector<std::pair<TSType, ValType>> Decode(const std::uint8_t* archive, size_t size);
+    // Appending version, to reuse the output between calls.
+    void Decode(const std::uint8_t* archive, size_t size, std::vector<std::pair<TSType, ValType>>& output);
+
+private:
+    // Decompresses into arena_ and returns the number of blocks, the frames start at arena_begin_.
+    std::uint32_t Decompress(const std::uint8_t* archive, size_t size);
+    // Splits the decompressed frames and hands each one to f.
+    template <typename F>
+    void ForEachFrame(std::uint32_t num_blocks, F f);
+
+    std::unordered_map<std::uint32_t, ArchiveDictionary> dictionaries_;
+    // The dictionary of the previous archive is kept in front of the output.
+    std::vector<std::uint8_t> arena_;
+    std::uint32_t arena_dictionary_ = 0;
+    size_t arena_begin_ = 0;
+    size_t arena_end_ = 0;
+};
+
+} // namespace compression
+#endif
@@ -0,0 +1,126 @@
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "archive.h"
+#include "compression.h"
+#include "workloads.h"
+
+// Archived groups of blocks from a family of similar series. Every group holds the blocks of one
+// series, archive_ratio is the archive size over the Serialize frames it replaces.
+// items_per_second counts decoded points, BM_FramesDecode is the baseline without the second stage.
+
+namespace {
+
+const int kPointsPerSeries = 2000;
+const int kFamilySize = 32;
+
+using Blocks = std::vector<std::unique_ptr<compression::EncodedDataBlock>>;
+
+std::vector<Blocks> Family(compression::Workload workload) {
+    std::vector<Blocks> family(kFamilySize);
+    for (int series = 0; series < kFamilySize; series++) {
+        for (auto& point : compression::GenerateWorkload(workload, kPointsPerSeries, series + 1)) {
+            Blocks& blocks = family[series];
+            if (!blocks.empty() && blocks.back()->WithinRange(point.first)) {
+                blocks.back()->Append(point.first, point.second);
+            } else {
+                blocks.emplace_back(new compression::EncodedDataBlock(point.first, point.second));
+            }
+        }
+    }
+    return family;
+}
+
+std::vector<const compression::EncodedDataBlock*> Pointers(const Blocks& blocks) {
+    std::vector<const compression::EncodedDataBlock*> pointers;
+    for (auto& block : blocks) {
+        pointers.push_back(block.get());
+    }
+    return pointers;
+}
+
+compression::Workload WorkloadArg(benchmark::State& state) {
+    return compression::AllWorkloads()[state.range(0)];
+}
+
+void Archive(benchmark::State& state, bool use_dictionary) {
+    auto family = Family(WorkloadArg(state));
+    // Trained on the first half of the family, archives made of the other half.
+    std::vector<const compression::EncodedDataBlock*> samples;
+    for (int series = 0; series < kFamilySize / 2; series++) {
+        auto pointers = Pointers(family[series]);
+        samples.insert(samples.end(), pointers.begin(), pointers.end());
+    }
+    auto dictionary = compression::TrainDictionary(samples);
+
+    std::vector<std::vector<std::uint8_t>> archives;
+    std::uint64_t frame_bytes = 0;
+    std::uint64_t archive_bytes = 0;
+    for (int series = kFamilySize / 2; series < kFamilySize; series++) {
+        archives.push_back(compression::ArchiveBlocks(Pointers(family[series]),
+            use_dictionary ? &dictionary : nullptr));
+        archive_bytes += archives.back().size();
+        for (auto& block : family[series]) {
+            frame_bytes += block->Serialize().size();
+        }
+    }
+
+    compression::ArchiveReader reader;
+    reader.AddDictionary(dictionary);
+    std::vector<std::pair<compression::TSType, compression::ValType>> points;
+    for (auto _ : state) {
+        for (auto& archive : archives) {
+            points.clear();
+            reader.Decode(archive.data(), archive.size(), points);
+            benchmark::DoNotOptimize(points.data());
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * kPointsPerSeries * (kFamilySize / 2));
+    state.counters["archive_ratio"] = static_cast<double>(archive_bytes) / frame_bytes;
+    state.SetLabel(compression::WorkloadName(WorkloadArg(state)));
+}
+
+} // namespace
+
+static void BM_FramesDecode(benchmark::State& state) {
+    auto family = Family(WorkloadArg(state));
+    std::vector<std::vector<std::uint8_t>> frames;
+    for (int series = kFamilySize / 2; series < kFamilySize; series++) {
+        for (auto& block : family[series]) {
+            frames.push_back(block->Serialize());
+        }
+    }
+    for (auto _ : state) {
+        for (auto& frame : frames) {
+            std::unique_ptr<compression::EncodedDataBlock> block(
+                compression::EncodedDataBlock::Deserialize(frame.data(), frame.size()));
+            benchmark::DoNotOptimize(block->Decode());
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * kPointsPerSeries * (kFamilySize / 2));
+    state.SetLabel(compression::WorkloadName(WorkloadArg(state)));
+}
+BENCHMARK(BM_FramesDecode)->DenseRange(0, 7);
+
+static void BM_ArchiveDecode(benchmark::State& state) {
+    Archive(state, false);
+}
+BENCHMARK(BM_ArchiveDecode)->DenseRange(0, 7);
+
+static void BM_ArchiveDecodeDictionary(benchmark::State& state) {
+    Archive(state, true);
+}
+BENCHMARK(BM_ArchiveDecodeDictionary)->DenseRange(0, 7);
+
+static void BM_ArchiveBlocks(benchmark::State& state) {
+    auto family = Family(WorkloadArg(state));
+    auto blocks = Pointers(family[0]);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(compression::ArchiveBlocks(blocks));
+    }
+    state.SetItemsProcessed(state.iterations() * kPointsPerSeries);
+    state.SetLabel(compression::WorkloadName(WorkloadArg(state)));
+}
+BENCHMARK(BM_ArchiveBlocks)->DenseRange(0, 7);
@@ -0,0 +1,162 @@
+#include <memory>
+#include <utility>
+#include <vector>
+#include "archive.h"
+#include "compression.h"
+#include "helpers.h"
+#include "workloads.h"
+#include "gtest/gtest.h"
+
+namespace compression {
+
+namespace {
+
+using Blocks = std::vector<std::unique_ptr<EncodedDataBlock>>;
+
+// The points of a workload cut into 2h blocks like the Encoder does.
+Blocks MakeBlocks(Workload workload, int num_points, std::uint64_t seed) {
+  Blocks blocks;
+  for (auto& point : GenerateWorkload(workload, num_points, seed)) {
+    if (!blocks.empty() && blocks.back()->WithinRange(point.first)) {
+      blocks.back()->Append(point.first, point.second);
+    } else {
+      blocks.emplace_back(new EncodedDataBlock(point.first, point.second));
+    }
+  }
+  return blocks;
+}
+
+std::vector<const EncodedDataBlock*> Pointers(const Blocks& blocks) {
+  std::vector<const EncodedDataBlock*> pointers;
+  for (auto& block : blocks) {
+    pointers.push_back(block.get());
+  }
+  return pointers;
+}
+
+std::vector<std::pair<TSType, ValType>> Points(const Blocks& blocks) {
+  std::vector<std::pair<TSType, ValType>> points;
+  for (auto& block : blocks) {
+    auto block_points = block->Decode();
+    points.insert(points.end(), block_points.begin(), block_points.end());
+  }
+  return points;
+}
+
+// Sets the checksum again after the archive was tampered with.
+void FixChecksum(std::vector<std::uint8_t>& archive) {
+  std::uint32_t crc = Crc32(archive.data(), 12);
+  crc = Crc32(archive.data() + 16, archive.size() - 16, crc);
+  for (int i = 0; i < 4; i++) {
+    archive[12 + i] = (crc >> (8 * i)) & 0xFF;
+  }
+}
+
+} // namespace
+
+TEST(Archive, RoundTripsEveryWorkload) {
+  ArchiveReader reader;
+  for (auto workload : AllWorkloads()) {
+    auto blocks = MakeBlocks(workload, 5000, 1);
+    auto archive = ArchiveBlocks(Pointers(blocks));
+    EXPECT_EQ(Points(blocks), reader.Decode(archive.data(), archive.size())) << WorkloadName(workload);
+
+    auto read = reader.Blocks(archive.data(), archive.size());
+    ASSERT_EQ(blocks.size(), read.size());
+    for (size_t i = 0; i < blocks.size(); i++) {
+      EXPECT_EQ(blocks[i]->Bytes(), read[i]->Bytes());
+    }
+  }
+  auto empty = ArchiveBlocks({});
+  EXPECT_TRUE(reader.Decode(empty.data(), empty.size()).empty());
+}
+
+TEST(Archive, ShrinksRepetitiveSeries) {
+  auto FrameBytes = [](const Blocks& blocks) {
+    std::uint64_t bytes = 0;
+    for (auto& block : blocks) {
+      bytes += block->Serialize().size();
+    }
+    return bytes;
+  };
+  auto regular = MakeBlocks(Workload::kRegular, 20000, 1);
+  EXPECT_LT(ArchiveBlocks(Pointers(regular)).size(), FrameBytes(regular) / 2);
+
+  // Noise doesn't compress, it's stored behind just the header.
+  auto noisy = MakeBlocks(Workload::kNoisyFloat, 20000, 1);
+  auto archive = ArchiveBlocks(Pointers(noisy));
+  EXPECT_EQ(FrameBytes(noisy) + 16, archive.size());
+  ArchiveReader reader;
+  EXPECT_EQ(Points(noisy), reader.Decode(archive.data(), archive.size()));
+}
+
+TEST(Archive, DictionaryOfTheFamily) {
+  // Blocks of the same kind of series from other hosts.
+  Blocks samples;
+  for (std::uint64_t seed = 1; seed <= 16; seed++) {
+    auto blocks = MakeBlocks(Workload::kRegular, 1000, seed);
+    for (auto& block : blocks) {
+      samples.push_back(std::move(block));
+    }
+  }
+  auto dictionary = TrainDictionary(Pointers(samples), 4 << 10);
+  ASSERT_NE(0U, dictionary.id);
+  ASSERT_FALSE(dictionary.bytes.empty());
+  EXPECT_LE(dictionary.bytes.size(), 4U << 10);
+
+  // A single block archive on its own has little to match against.
+  auto blocks = MakeBlocks(Workload::kRegular, 700, 99);
+  ASSERT_EQ(1U, blocks.size());
+  auto plain = ArchiveBlocks(Pointers(blocks));
+  auto with_dictionary = ArchiveBlocks(Pointers(blocks), &dictionary);
+  EXPECT_LT(with_dictionary.size(), plain.size());
+
+  ArchiveReader reader;
+  EXPECT_THROW(reader.Decode(with_dictionary.data(), with_dictionary.size()), ParsingError);
+  reader.AddDictionary(dictionary);
+  EXPECT_EQ(Points(blocks), reader.Decode(with_dictionary.data(), with_dictionary.size()));
+
+  // The arena switches between dictionaries and none.
+  auto other = TrainDictionary(Pointers(MakeBlocks(Workload::kJittered, 5000, 3)), 1 << 10);
+  reader.AddDictionary(other);
+  auto other_archive = ArchiveBlocks(Pointers(blocks), &other);
+  for (int i = 0; i < 2; i++) {
+    EXPECT_EQ(Points(blocks), reader.Decode(other_archive.data(), other_archive.size()));
+    EXPECT_EQ(Points(blocks), reader.Decode(plain.data(), plain.size()));
+    EXPECT_EQ(Points(blocks), reader.Decode(with_dictionary.data(), with_dictionary.size()));
+  }
+}
+
+TEST(Archive, RejectsCorruption) {
+  auto blocks = MakeBlocks(Workload::kGaps, 3000, 5);
+  auto archive = ArchiveBlocks(Pointers(blocks));
+  ArchiveReader reader;
+
+  auto flipped = archive;
+  flipped[flipped.size() / 2] ^= 0x10;
+  EXPECT_THROW(reader.Decode(flipped.data(), flipped.size()), ParsingError);
+  EXPECT_THROW(reader.Decode(archive.data(), archive.size() - 1), ParsingError);
+  EXPECT_THROW(reader.Decode(archive.data(), 10), ParsingError);
+
+  // Intact checksum, but broken content.
+  auto cut = archive;
+  cut.resize(cut.size() - 3);
+  FixChecksum(cut);
+  EXPECT_THROW(reader.Decode(cut.data(), cut.size()), ParsingError);
+
+  // A match reaching before the start of the output.
+  std::vector<std::uint8_t> bad_offset = {0, 0, 0, 0, 1, 0, 0, 0, 8, 0, 0, 0, 0, 0, 0, 0,
+                                          0x10, 'x', 0x40, 0x00, 0x00};
+  FixChecksum(bad_offset);
+  EXPECT_THROW(reader.Decode(bad_offset.data(), bad_offset.size()), ParsingError);
+
+  auto wrong_count = archive;
+  wrong_count[4]++;
+  FixChecksum(wrong_count);
+  EXPECT_THROW(reader.Decode(wrong_count.data(), wrong_count.size()), ParsingError);
+
+  // The reader is still fine afterwards.
+  EXPECT_EQ(Points(blocks), reader.Decode(archive.data(), archive.size()));
+}
+
+} // namespace compression
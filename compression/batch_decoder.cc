@@ -0,0 +1,234 @@
+#include <memory>
+#include <utility>
+#include <vector>
+#include "batch_decoder.h"
+#include "bit_reader.h"
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define COMPRESSION_HAVE_AVX2_KERNEL 1
+#include <immintrin.h>
+#endif
+
+namespace compression {
+
+namespace {
+
+using Lane = std::vector<std::pair<TSType, ValType>>;
+
+// The kernels may read a whole word past the end of a lane, even when the stream is corrupted.
+const int kArenaPadding = 64;
+
+// Decoding state of all the lanes, positions are kept apart so the scalar kernel can scan them.
+struct Lanes {
+    std::vector<std::uint64_t> pos;
+    std::vector<std::uint64_t> end;
+    std::vector<StreamState> state;
+
+    explicit Lanes(size_t n): pos(n), end(n), state(n) {}
+};
+
+void ReadHeaders(const std::uint8_t* arena, Lanes& lanes, std::vector<Lane>& output) {
+    auto peek = [arena](std::uint64_t pos) { return PeekBits(arena, pos); };
+    for (size_t i = 0; i < output.size(); i++) {
+        ReadBlockHeader(peek, lanes.pos[i], lanes.state[i]);
+        lanes.pos[i] += kBlockHeaderBits;
+        output[i].push_back({lanes.state[i].ts, DoubleFromInt(lanes.state[i].val)});
+    }
+}
+
+// Portable kernel, lanes take turns so the CPU can overlap their independent dependency chains.
+void DecodeScalar(const std::uint8_t* arena, Lanes& lanes, std::vector<Lane>& output) {
+    auto peek = [arena](std::uint64_t pos) { return PeekBits(arena, pos); };
+    bool any_active = true;
+    while (any_active) {
+        any_active = false;
+        for (size_t i = 0; i < output.size(); i++) {
+            if (lanes.pos[i] >= lanes.end[i]) {
+                continue;
+            }
+            any_active = true;
+            auto& state = lanes.state[i];
+            lanes.pos[i] = DecodePoint(peek, lanes.pos[i], state);
+            output[i].push_back({state.ts, DoubleFromInt(state.val)});
+        }
+    }
+}
+
+#ifdef COMPRESSION_HAVE_AVX2_KERNEL
+
+__attribute__((target("avx2")))
+inline __m256i Peek4(const std::uint8_t* arena, __m256i pos) {
+    const __m256i kByteSwap = _mm256_setr_epi8(
+        7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8,
+        7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8);
+    __m256i words = _mm256_i64gather_epi64(
+        reinterpret_cast<const long long*>(arena), _mm256_srli_epi64(pos, 3), 1);
+    words = _mm256_shuffle_epi8(words, kByteSwap);
+    return _mm256_sllv_epi64(words, _mm256_and_si256(pos, _mm256_set1_epi64x(7)));
+}
+
+// Same steps as DecodeScalar, four lanes per register. Lanes which reached their end are masked out.
+// Variable shifts by 64 or more give 0 in AVX2, which covers the empty fields without branches.
+__attribute__((target("avx2")))
+void DecodeAVX2(const std::uint8_t* arena, Lanes& lanes, std::vector<Lane>& output) {
+    const __m256i kZero = _mm256_setzero_si256();
+    const __m256i kOne = _mm256_set1_epi64x(1);
+    const __m256i kSixtyFour = _mm256_set1_epi64x(64);
+    const __m256i kSixBits = _mm256_set1_epi64x(0x3F);
+    const __m256i kAllOnes = _mm256_set1_epi64x(-1);
+
+    for (size_t group = 0; group < output.size(); group += 4) {
+        size_t group_size = output.size() - group < 4 ? output.size() - group : 4;
+        alignas(32) std::uint64_t state[7][4] = {};
+        for (size_t i = 0; i < group_size; i++) {
+            auto& lane_state = lanes.state[group + i];
+            state[0][i] = lanes.pos[group + i];
+            state[1][i] = lanes.end[group + i];
+            state[2][i] = lane_state.ts;
+            state[3][i] = lane_state.delta;
+            state[4][i] = lane_state.val;
+            state[5][i] = lane_state.leading_zeros;
+            state[6][i] = lane_state.meaningful_bits;
+        }
+        __m256i pos = _mm256_load_si256(reinterpret_cast<const __m256i*>(state[0]));
+        __m256i end = _mm256_load_si256(reinterpret_cast<const __m256i*>(state[1]));
+        __m256i ts = _mm256_load_si256(reinterpret_cast<const __m256i*>(state[2]));
+        __m256i delta = _mm256_load_si256(reinterpret_cast<const __m256i*>(state[3]));
+        __m256i val = _mm256_load_si256(reinterpret_cast<const __m256i*>(state[4]));
+        __m256i leading_zeros = _mm256_load_si256(reinterpret_cast<const __m256i*>(state[5]));
+        __m256i meaningful_bits = _mm256_load_si256(reinterpret_cast<const __m256i*>(state[6]));
+
+        while (true) {
+            __m256i active = _mm256_cmpgt_epi64(end, pos);
+            int active_mask = _mm256_movemask_pd(_mm256_castsi256_pd(active));
+            if (!active_mask) {
+                break;
+            }
+            __m256i word = Peek4(arena, pos);
+
+            // Leading ones of the timestamp control, m1..m4 are 0 or 1.
+            __m256i m1 = _mm256_srli_epi64(word, 63);
+            __m256i m2 = _mm256_and_si256(m1, _mm256_srli_epi64(word, 62));
+            __m256i m3 = _mm256_and_si256(m2, _mm256_srli_epi64(word, 61));
+            __m256i m4 = _mm256_and_si256(m3, _mm256_srli_epi64(word, 60));
+            m2 = _mm256_and_si256(m2, kOne);
+            m3 = _mm256_and_si256(m3, kOne);
+            m4 = _mm256_and_si256(m4, kOne);
+            // Lengths 1, 2, 3, 4, 4 and delta of delta widths 0, 7, 9, 12, 32.
+            __m256i control_len = _mm256_add_epi64(_mm256_add_epi64(kOne, m1), _mm256_add_epi64(m2, m3));
+            __m256i delta_bits = _mm256_add_epi64(
+                _mm256_add_epi64(_mm256_mul_epu32(m1, _mm256_set1_epi64x(7)),
+                                 _mm256_mul_epu32(m2, _mm256_set1_epi64x(2))),
+                _mm256_add_epi64(_mm256_mul_epu32(m3, _mm256_set1_epi64x(3)),
+                                 _mm256_mul_epu32(m4, _mm256_set1_epi64x(20))));
+
+            // Sign extended delta of delta, there is no 64 bit arithmetic shift in AVX2.
+            __m256i field = _mm256_sllv_epi64(word, control_len);
+            __m256i delta_of_delta = _mm256_srlv_epi64(field, _mm256_sub_epi64(kSixtyFour, delta_bits));
+            __m256i negative = _mm256_and_si256(
+                _mm256_cmpgt_epi64(kZero, field), _mm256_cmpgt_epi64(delta_bits, kZero));
+            delta_of_delta = _mm256_or_si256(delta_of_delta,
+                _mm256_and_si256(negative, _mm256_sllv_epi64(kAllOnes, delta_bits)));
+
+            __m256i new_delta = _mm256_add_epi64(delta, delta_of_delta);
+            delta = _mm256_blendv_epi8(delta, new_delta, active);
+            ts = _mm256_blendv_epi8(ts, _mm256_add_epi64(ts, new_delta), active);
+
+            // Value control: 0 is a repeat, 10 reuses the window, 11 carries a new one.
+            __m256i consumed = _mm256_add_epi64(control_len, delta_bits);
+            __m256i header = _mm256_sllv_epi64(word, consumed);
+            __m256i c0 = _mm256_srli_epi64(header, 63);
+            __m256i c1 = _mm256_and_si256(c0, _mm256_srli_epi64(header, 62));
+            __m256i has_value = _mm256_cmpeq_epi64(c0, kOne);
+            __m256i new_window = _mm256_and_si256(_mm256_cmpeq_epi64(c1, kOne), active);
+            leading_zeros = _mm256_blendv_epi8(leading_zeros,
+                _mm256_and_si256(_mm256_srli_epi64(header, 56), kSixBits), new_window);
+            __m256i new_meaningful_bits = _mm256_and_si256(_mm256_srli_epi64(header, 50), kSixBits);
+            new_meaningful_bits = _mm256_or_si256(new_meaningful_bits,
+                _mm256_and_si256(_mm256_cmpeq_epi64(new_meaningful_bits, kZero), kSixtyFour));
+            meaningful_bits = _mm256_blendv_epi8(meaningful_bits, new_meaningful_bits, new_window);
+            consumed = _mm256_add_epi64(consumed, _mm256_add_epi64(_mm256_add_epi64(kOne, c0),
+                _mm256_mul_epu32(_mm256_and_si256(c1, kOne), _mm256_set1_epi64x(12))));
+
+            __m256i used_bits = _mm256_and_si256(meaningful_bits, has_value);
+            __m256i payload_pos = _mm256_add_epi64(pos, consumed);
+            __m256i high = _mm256_srli_epi64(Peek4(arena, payload_pos), 32);
+            __m256i low = _mm256_srli_epi64(Peek4(arena, _mm256_add_epi64(payload_pos, _mm256_set1_epi64x(32))), 32);
+            __m256i payload = _mm256_srlv_epi64(_mm256_or_si256(_mm256_slli_epi64(high, 32), low),
+                _mm256_sub_epi64(kSixtyFour, used_bits));
+            __m256i xored = _mm256_sllv_epi64(payload,
+                _mm256_sub_epi64(_mm256_sub_epi64(kSixtyFour, used_bits), leading_zeros));
+            val = _mm256_blendv_epi8(val, _mm256_xor_si256(val, xored), active);
+            pos = _mm256_blendv_epi8(pos, _mm256_add_epi64(payload_pos, used_bits), active);
+
+            alignas(32) std::uint64_t out_ts[4];
+            alignas(32) std::uint64_t out_val[4];
+            _mm256_store_si256(reinterpret_cast<__m256i*>(out_ts), ts);
+            _mm256_store_si256(reinterpret_cast<__m256i*>(out_val), val);
+            for (size_t i = 0; i < group_size; i++) {
+                if (active_mask & (1 << i)) {
+                    output[group + i].push_back({out_ts[i], DoubleFromInt(out_val[i])});
+                }
+            }
+        }
+    }
+}
+
+#endif // COMPRESSION_HAVE_AVX2_KERNEL
+
+} // namespace
+
+BatchDecoder::BatchDecoder(BatchKernel kernel): kernel_(kernel) {
+    if (kernel_ == BatchKernel::kAuto) {
+        kernel_ = AVX2Supported() ? BatchKernel::kAVX2 : BatchKernel::kScalar;
+    }
+    if (kernel_ == BatchKernel::kAVX2 && !AVX2Supported()) {
+        throw std::invalid_argument("AVX2 batch kernel requested, but the CPU doesn't support it");
+    }
+}
+
+bool BatchDecoder::AVX2Supported() {
+#ifdef COMPRESSION_HAVE_AVX2_KERNEL
+    return __builtin_cpu_supports("avx2");
+#else
+    return false;
+#endif
+}
+
+std::vector<std::vector<std::pair<TSType, ValType>>> BatchDecoder::Decode(
+    const std::vector<EncodedDataBlock*>& blocks) {
+    std::vector<Lane> output(blocks.size());
+    Lanes lanes(blocks.size());
+    std::vector<std::shared_ptr<EncodedDataBlock>> loaded;
+    loaded.reserve(blocks.size());
+    for (auto block : blocks) {
+        loaded.push_back(block->Load());
+    }
+
+    // Every lane starts on a word boundary.
+    size_t arena_size = kArenaPadding;
+    for (auto& block : loaded) {
+        arena_size += (block->Bytes().size() + 7) & ~size_t(7);
+    }
+    arena_.assign(arena_size, 0);
+    size_t offset = 0;
+    for (size_t i = 0; i < loaded.size(); i++) {
+        auto& bytes = loaded[i]->Bytes();
+        std::copy(bytes.begin(), bytes.end(), arena_.begin() + offset);
+        lanes.pos[i] = offset * 8;
+        lanes.end[i] = offset * 8 + loaded[i]->SizeInBits();
+        offset += (bytes.size() + 7) & ~size_t(7);
+    }
+
+    ReadHeaders(arena_.data(), lanes, output);
+#ifdef COMPRESSION_HAVE_AVX2_KERNEL
+    if (kernel_ == BatchKernel::kAVX2) {
+        DecodeAVX2(arena_.data(), lanes, output);
+        return output;
+    }
+#endif
+    DecodeScalar(arena_.data(), lanes, output);
+    return output;
+}
+
+} // namespace compression
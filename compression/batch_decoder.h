@@ -0,0 +1,49 @@
+#ifndef COMPRESSION_BATCH_DECODER_H
+#define COMPRESSION_BATCH_DECODER_H
+
+#include <utility>
+#include <vector>
+#include <cinttypes>
+#include "common.h"
+#include "compression.h"
+
+namespace compression {
+
+// Which implementation BatchDecoder runs. kAuto picks the widest one the CPU supports.
+enum class BatchKernel {
+    kAuto,
+    kScalar,
+    kAVX2,
+};
+
+// Decodes many independent blocks at once, e.g. one metric across a fleet.
+//
+// Every block gets its own lane and all lanes are advanced in lockstep, so the
+// serial dependency chain of a single Gorilla stream is spread across SIMD lanes
+// (AVX2, 4 streams per register) or, in the scalar kernel, across independent
+// instructions the CPU can overlap.
+class BatchDecoder {
+
+public:
+    explicit BatchDecoder(BatchKernel kernel = BatchKernel::kAuto);
+
+    // Returns one vector of points per block, in the order of the input. Cold blocks are
+    // loaded first, see EncodedDataBlock::Load.
+    std::vector<std::vector<std::pair<TSType, ValType>>> Decode(
+        const std::vector<EncodedDataBlock*>& blocks);
+
+    // The kernel actually used, never kAuto.
+    BatchKernel Kernel() const {
+        return kernel_;
+    }
+
+    static bool AVX2Supported();
+
+private:
+    BatchKernel kernel_;
+    // Padded copy of all the lanes, so the inner loops can read 8 bytes at any position.
+    std::vector<std::uint8_t> arena_;
+};
+
+} // namespace compression
+#endif
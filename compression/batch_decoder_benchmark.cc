@@ -0,0 +1,70 @@
+#include <vector>
+#include <utility>
+
+#include "benchmark/benchmark.h"
+#include "batch_decoder.h"
+#include "compression.h"
+
+namespace {
+
+const int kPointsPerSeries = 720;
+
+std::vector<compression::EncodedDataBlock*> MakeBlocks(int num_series) {
+    std::vector<compression::EncodedDataBlock*> blocks;
+    for (int s = 0; s < num_series; s++) {
+        auto block = new compression::EncodedDataBlock(2 * 60 * 60, s);
+        for (int i = 1; i < kPointsPerSeries; i++) {
+            block->Append(2 * 60 * 60 + i * 10 + (i % 5 == 0), s + (i % 13) * 0.25);
+        }
+        blocks.push_back(block);
+    }
+    return blocks;
+}
+
+void DecodeBatch(benchmark::State& state, compression::BatchKernel kernel) {
+    if (kernel == compression::BatchKernel::kAVX2 && !compression::BatchDecoder::AVX2Supported()) {
+        state.SkipWithError("AVX2 not supported");
+        return;
+    }
+    auto blocks = MakeBlocks(state.range(0));
+    compression::BatchDecoder decoder(kernel);
+    for (auto _ : state) {
+        auto lanes = decoder.Decode(blocks);
+        benchmark::DoNotOptimize(lanes.data());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0) * kPointsPerSeries);
+    for (auto block : blocks) {
+        delete block;
+    }
+}
+
+} // namespace
+
+// Baseline, every series decoded one after another with DataIterator.
+static void BM_DecodeSeriesOneByOne(benchmark::State& state) {
+    auto blocks = MakeBlocks(state.range(0));
+    for (auto _ : state) {
+        std::vector<std::vector<std::pair<compression::TSType, compression::ValType>>> lanes;
+        for (auto block : blocks) {
+            lanes.emplace_back(block->begin(), block->end());
+        }
+        benchmark::DoNotOptimize(lanes.data());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0) * kPointsPerSeries);
+    for (auto block : blocks) {
+        delete block;
+    }
+}
+BENCHMARK(BM_DecodeSeriesOneByOne)->Arg(8)->Arg(16)->Arg(64);
+
+static void BM_BatchDecodeScalar(benchmark::State& state) {
+    DecodeBatch(state, compression::BatchKernel::kScalar);
+}
+BENCHMARK(BM_BatchDecodeScalar)->Arg(8)->Arg(16)->Arg(64);
+
+static void BM_BatchDecodeAVX2(benchmark::State& state) {
+    DecodeBatch(state, compression::BatchKernel::kAVX2);
+}
+BENCHMARK(BM_BatchDecodeAVX2)->Arg(8)->Arg(16)->Arg(64);
+
+BENCHMARK_MAIN();
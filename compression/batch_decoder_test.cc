@@ -0,0 +1,118 @@
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+#include "batch_decoder.h"
+#include "compression.h"
+#include "workloads.h"
+#include "gtest/gtest.h"
+
+namespace compression {
+
+// Makes a skipped kernel visible, in the output and as a test property in the XML report. The
+// gtest pinned in WORKSPACE (1.7) has no GTEST_SKIP.
+void LogSkipped(const std::string& reason) {
+  ::testing::Test::RecordProperty("skipped", reason);
+  std::cout << "[  SKIPPED ] " << reason << std::endl;
+}
+
+std::vector<EncodedDataBlock*> GenerateBlocks(int num_series, int max_points) {
+  std::mt19937_64 rng(42);
+  std::uniform_int_distribution<int> jitter(-700, 700);
+  std::uniform_int_distribution<int> length(1, max_points);
+  std::uniform_real_distribution<double> step(-1.0, 1.0);
+  std::vector<EncodedDataBlock*> blocks;
+  for (int s = 0; s < num_series; s++) {
+    TSType ts = 2 * 60 * 60 + s;
+    double val = 100 + s;
+    auto block = new EncodedDataBlock(ts, val);
+    int n = length(rng);
+    for (int i = 1; i < n; i++) {
+      // Mix of regular intervals, jitter hitting the wider buckets, repeats and noisy values.
+      ts += (i % 7 == 0) ? 10 + jitter(rng) + 700 : 10;
+      if (i % 3 != 0) {
+        val += step(rng);
+      }
+      block->Append(ts, val);
+    }
+    blocks.push_back(block);
+  }
+  return blocks;
+}
+
+void ExpectMatchesIterator(BatchKernel kernel, int num_series, int max_points) {
+  auto blocks = GenerateBlocks(num_series, max_points);
+  BatchDecoder decoder(kernel);
+  auto lanes = decoder.Decode(blocks);
+  ASSERT_EQ(blocks.size(), lanes.size());
+  for (size_t i = 0; i < blocks.size(); i++) {
+    // Decode() shares the kernels' fast path, DataIterator is the independent reference.
+    std::vector<std::pair<TSType, ValType>> expected(blocks[i]->begin(), blocks[i]->end());
+    ASSERT_EQ(expected.size(), lanes[i].size()) << "lane " << i;
+    for (size_t j = 0; j < expected.size(); j++) {
+      ASSERT_EQ(expected[j].first, lanes[i][j].first) << "lane " << i << " point " << j;
+      ASSERT_EQ(DoubleAsInt(expected[j].second), DoubleAsInt(lanes[i][j].second))
+          << "lane " << i << " point " << j;
+    }
+  }
+  for (auto block : blocks) {
+    delete block;
+  }
+}
+
+TEST(BatchDecoder, ScalarMatchesIterator) {
+  ExpectMatchesIterator(BatchKernel::kScalar, 1, 1);
+  ExpectMatchesIterator(BatchKernel::kScalar, 13, 500);
+  ExpectMatchesIterator(BatchKernel::kScalar, 64, 200);
+}
+
+TEST(BatchDecoder, AVX2MatchesIterator) {
+  if (!BatchDecoder::AVX2Supported()) {
+#ifdef GTEST_SKIP
+    GTEST_SKIP() << "no AVX2 on this host";
+#else
+    LogSkipped("no AVX2 on this host, the AVX2 kernel didn't run");
+    return;
+#endif
+  }
+  ExpectMatchesIterator(BatchKernel::kAVX2, 1, 1);
+  ExpectMatchesIterator(BatchKernel::kAVX2, 13, 500);
+  ExpectMatchesIterator(BatchKernel::kAVX2, 64, 200);
+}
+
+TEST(BatchDecoder, AllWorkloads) {
+  std::vector<EncodedDataBlock*> blocks;
+  for (auto workload : AllWorkloads()) {
+    auto points = GenerateWorkload(workload, 300);
+    auto block = new EncodedDataBlock(points[0].first, points[0].second);
+    for (size_t i = 1; i < points.size() && block->WithinRange(points[i].first); i++) {
+      block->Append(points[i].first, points[i].second);
+    }
+    blocks.push_back(block);
+  }
+  for (auto kernel : {BatchKernel::kScalar, BatchKernel::kAVX2}) {
+    if (kernel == BatchKernel::kAVX2 && !BatchDecoder::AVX2Supported()) {
+      LogSkipped("no AVX2 on this host, only the scalar kernel ran");
+      continue;
+    }
+    BatchDecoder decoder(kernel);
+    auto lanes = decoder.Decode(blocks);
+    for (size_t i = 0; i < blocks.size(); i++) {
+      std::vector<std::pair<TSType, ValType>> expected(blocks[i]->begin(), blocks[i]->end());
+      EXPECT_EQ(expected, lanes[i]) << WorkloadName(AllWorkloads()[i]);
+    }
+  }
+  for (auto block : blocks) {
+    delete block;
+  }
+}
+
+TEST(BatchDecoder, AutoPicksSupportedKernel) {
+  BatchDecoder decoder;
+  EXPECT_NE(BatchKernel::kAuto, decoder.Kernel());
+  EXPECT_TRUE(decoder.Decode({}).empty());
+}
+
+} // namespace compression
@@ -0,0 +1,288 @@
+#ifndef COMPRESSION_BIT_READER_H
+#define COMPRESSION_BIT_READER_H
+
+#include <cstring>
+#include <cinttypes>
+#include <string>
+#include <utility>
+#include <vector>
+#include "common.h"
+#include "compression.h"
+#include "policy.h"
+#include "stats.h"
+
+// Word at a time reading of encoded streams, shared by the decoders.
+// ReadBlockHeader and DecodePoint don't check bounds or validate the stream, it has to be
+// trusted (encoded in this process) or validated up front with the Checked variants,
+// see EncodedDataBlock::Deserialize. The With variants decode any layout from policy.h, the
+// plain ones the GorillaPolicy layout of EncodedDataBlock.
+
+namespace compression {
+
+// Block header: aligned timestamp, delta from it and the first value.
+const int kBlockHeaderBits = PolicyTraits<GorillaPolicy>::kHeaderBits;
+
+// Bits past pos that DecodePoint may load: the furthest word it peeks starts 82 bits
+// after pos (36 bits of timestamp, 14 of value header and 32 of payload).
+const int kDecodePointReach = PolicyTraits<GorillaPolicy>::kDecodeReach;
+
+// Length of the timestamp control sequence and of the delta of delta that follows it,
+// indexed by the number of leading ones: 0b0, 0b10, 0b110, 0b1110 and 0b1111.
+template <typename Policy>
+struct TSControlTable {
+    static constexpr int kControlLen[] = {1, 2, 3, 4, 4};
+    static constexpr int kDeltaBits[] = {Policy::TSDeltaBits(0), Policy::TSDeltaBits(1),
+        Policy::TSDeltaBits(2), Policy::TSDeltaBits(3), Policy::TSDeltaBits(4)};
+};
+
+template <typename Policy>
+constexpr int TSControlTable<Policy>::kControlLen[];
+template <typename Policy>
+constexpr int TSControlTable<Policy>::kDeltaBits[];
+
+// Decoding state carried from one point to the next.
+struct StreamState {
+    TSType ts = 0;
+    std::int64_t delta = 0;
+    std::uint64_t val = 0;
+    int leading_zeros = 0;
+    int meaningful_bits = 0;
+};
+
+// Returns 64 bits starting at bit position pos, only the top 57 are guaranteed to be valid.
+// Loads 8 bytes, so pos must be at least 8 bytes before the end of data.
+inline std::uint64_t PeekBits(const std::uint8_t* data, std::uint64_t pos) {
+    std::uint64_t word;
+    std::memcpy(&word, data + (pos >> 3), sizeof(word));
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    word = __builtin_bswap64(word);
+#endif
+    return word << (pos & 7);
+}
+
+// Same as PeekBits, but reads as if data was followed by zeros.
+inline std::uint64_t PeekBitsTail(const std::uint8_t* data, std::uint64_t size, std::uint64_t pos) {
+    std::uint8_t word[8] = {};
+    std::uint64_t byte_offset = pos >> 3;
+    if (byte_offset < size) {
+        std::memcpy(word, data + byte_offset, size - byte_offset < 8 ? size - byte_offset : 8);
+    }
+    return PeekBits(word, pos & 7);
+}
+
+inline std::uint64_t TopBits(std::uint64_t word, int num_bits) {
+    return num_bits ? word >> (64 - num_bits) : 0;
+}
+
+// Reads up to 64 bits, peek is one of the functions above bound to a buffer.
+template <typename Peek>
+inline std::uint64_t ReadBitsWith(const Peek& peek, std::uint64_t pos, int num_bits) {
+    if (num_bits <= 56) {
+        return TopBits(peek(pos), num_bits);
+    }
+    return TopBits(peek(pos), num_bits - 32) << 32 | TopBits(peek(pos + num_bits - 32), 32);
+}
+
+inline int TSControlLeadingOnes(std::uint64_t word) {
+    std::uint64_t inverted = ~word;
+    int ones = inverted ? __builtin_clzll(inverted) : 64;
+    return ones < 4 ? ones : 4;
+}
+
+// Reads the block header, the first point of the block, into state.
+template <typename Policy, typename Peek>
+inline void ReadBlockHeaderWith(const Peek& peek, std::uint64_t pos, StreamState& state) {
+    TSType aligned_timestamp = ReadBitsWith(peek, pos, 64);
+    std::uint64_t delta = ReadBitsWith(peek, pos + 64, Policy::kHeaderDeltaBits);
+    state.ts = aligned_timestamp + delta;
+    state.delta = delta;
+    state.val = ReadBitsWith(peek, pos + 64 + Policy::kHeaderDeltaBits, 64);
+}
+
+template <typename Peek>
+inline void ReadBlockHeader(const Peek& peek, std::uint64_t pos, StreamState& state) {
+    ReadBlockHeaderWith<GorillaPolicy>(peek, pos, state);
+}
+
+// Decodes the timestamp at pos into state and returns the position after it.
+template <typename Peek>
+inline std::uint64_t DecodeTimestamp(const Peek& peek, std::uint64_t pos, StreamState& state) {
+    std::uint64_t word = peek(pos);
+    int leading_ones = TSControlLeadingOnes(word);
+    int control_len = TSControlTable<GorillaPolicy>::kControlLen[leading_ones];
+    int delta_bits = TSControlTable<GorillaPolicy>::kDeltaBits[leading_ones];
+    if (delta_bits) {
+        state.delta += static_cast<std::int64_t>(word << control_len) >> (64 - delta_bits);
+    }
+    state.ts += state.delta;
+    return pos + control_len + delta_bits;
+}
+
+// Decodes the value of a point from the header word and returns the bits consumed after
+// the timestamp, with the payload read from pos on.
+template <typename Policy, typename Peek>
+inline int DecodeValueFields(const Peek& peek, std::uint64_t pos, std::uint64_t header, int consumed,
+    StreamState& state) {
+    if (Policy::kValueCodec == ValueCodec::kRaw) {
+        state.val = ReadBitsWith(peek, pos + consumed, 64);
+        return consumed + 64;
+    }
+    if (!(header >> 63)) {
+        return consumed + 1;
+    }
+    if ((header >> 62) & 1) {
+        state.leading_zeros = (header >> (62 - Policy::kLeadingZeroBits)) & ((1 << Policy::kLeadingZeroBits) - 1);
+        state.meaningful_bits = (header >> (56 - Policy::kLeadingZeroBits)) & 0x3F;
+        if (state.meaningful_bits == 0) {
+            // 0 stands for all 64 bits.
+            state.meaningful_bits = 64;
+        }
+        consumed += 2 + Policy::kLeadingZeroBits + 6;
+    } else {
+        consumed += 2;
+    }
+    std::uint64_t xored_shifted = ReadBitsWith(peek, pos + consumed, state.meaningful_bits);
+    state.val ^= xored_shifted << (64 - state.meaningful_bits - state.leading_zeros);
+    return consumed + state.meaningful_bits;
+}
+
+// Decodes the value at pos into state and returns the position after it.
+template <typename Peek>
+inline std::uint64_t DecodeValue(const Peek& peek, std::uint64_t pos, StreamState& state) {
+    return pos + DecodeValueFields<GorillaPolicy>(peek, pos, peek(pos), 0, state);
+}
+
+// Decodes the point starting at pos into state and returns the position of the next one.
+// Same as DecodeValue(peek, DecodeTimestamp(peek, pos, state), state), fused so that one peek
+// covers both controls.
+template <typename Policy, typename Peek>
+inline std::uint64_t DecodePointWith(const Peek& peek, std::uint64_t pos, StreamState& state) {
+    // Timestamp control, delta of delta and the value header fit in one word (at most 50 bits
+    // for GorillaPolicy, PolicyTraits checks the others).
+    std::uint64_t word = peek(pos);
+    int leading_ones = TSControlLeadingOnes(word);
+    int consumed = TSControlTable<Policy>::kControlLen[leading_ones];
+    int delta_bits = TSControlTable<Policy>::kDeltaBits[leading_ones];
+    if (delta_bits) {
+        state.delta += static_cast<std::int64_t>(word << consumed) >> (64 - delta_bits);
+    }
+    consumed += delta_bits;
+    state.ts += state.delta;
+    return pos + DecodeValueFields<Policy>(peek, pos, word << consumed, consumed, state);
+}
+
+template <typename Peek>
+inline std::uint64_t DecodePoint(const Peek& peek, std::uint64_t pos, StreamState& state) {
+    return DecodePointWith<GorillaPolicy>(peek, pos, state);
+}
+
+// Appends all the points of a trusted block stream with the layout of Policy to output. Words
+// are loaded directly while they are far enough from the end, then with PeekBitsTail.
+template <typename Policy>
+inline void DecodeStreamWith(const BitStream& stream, std::vector<std::pair<TSType, ValType>>& output) {
+    const std::uint8_t* data = stream.data.data();
+    std::uint64_t size = stream.data.size();
+    auto peek = [data](std::uint64_t pos) { return PeekBits(data, pos); };
+    auto peek_tail = [data, size](std::uint64_t pos) { return PeekBitsTail(data, size, pos); };
+
+    StreamState state;
+    ReadBlockHeaderWith<Policy>(peek_tail, 0, state);
+    output.push_back({state.ts, DoubleFromInt(state.val)});
+    std::uint64_t pos = PolicyTraits<Policy>::kHeaderBits;
+    std::uint64_t end = stream.SizeInBits();
+    std::uint64_t reach = PolicyTraits<Policy>::kDecodeReach;
+    std::uint64_t fast_end = size * 8 > reach ? size * 8 - reach : 0;
+    while (pos < fast_end) {
+        pos = DecodePointWith<Policy>(peek, pos, state);
+        output.push_back({state.ts, DoubleFromInt(state.val)});
+    }
+    while (pos < end) {
+        pos = DecodePointWith<Policy>(peek_tail, pos, state);
+        output.push_back({state.ts, DoubleFromInt(state.val)});
+    }
+}
+
+// Checked ReadBlockHeader, returns the aligned start of the block.
+template <typename Policy, typename Peek>
+inline TSType ReadBlockHeaderCheckedWith(const Peek& peek, std::uint64_t size_bits, StreamState& state) {
+    if (size_bits < PolicyTraits<Policy>::kHeaderBits) {
+        ThrowParsingError("block shorter than its header");
+    }
+    ReadBlockHeaderWith<Policy>(peek, 0, state);
+    TSType start_ts = ReadBitsWith(peek, 0, 64);
+    TSType block_ticks = PolicyTraits<Policy>::kBlockTicks;
+    if (start_ts % block_ticks || state.ts - start_ts >= block_ticks) {
+        ThrowParsingError("block header timestamp isn't aligned");
+    }
+    return start_ts;
+}
+
+template <typename Peek>
+inline TSType ReadBlockHeaderChecked(const Peek& peek, std::uint64_t size_bits, StreamState& state) {
+    return ReadBlockHeaderCheckedWith<GorillaPolicy>(peek, size_bits, state);
+}
+
+// Same steps as DecodePoint, with every field checked before it's used. The point has to end
+// within size_bits and its timestamp within the block starting at start_ts.
+template <typename Policy, typename Peek>
+inline std::uint64_t DecodePointCheckedWith(const Peek& peek, std::uint64_t pos, std::uint64_t size_bits,
+    TSType start_ts, StreamState& state, [[maybe_unused]] BlockCounters& counters) {
+    std::uint64_t word = peek(pos);
+    int leading_ones = TSControlLeadingOnes(word);
+    int consumed = TSControlTable<Policy>::kControlLen[leading_ones];
+    int delta_bits = TSControlTable<Policy>::kDeltaBits[leading_ones];
+    if (delta_bits) {
+        state.delta += static_cast<std::int64_t>(word << consumed) >> (64 - delta_bits);
+    }
+    consumed += delta_bits;
+    state.ts += state.delta;
+    TSType block_ticks = PolicyTraits<Policy>::kBlockTicks;
+    if (state.ts < start_ts || state.ts - start_ts >= block_ticks) {
+        ThrowParsingError("timestamp " + std::to_string(state.ts) + " outside of the block");
+    }
+    COMPRESSION_STATS(counters.ts_buckets[leading_ones]++);
+
+    std::uint64_t header = word << consumed;
+    if (Policy::kValueCodec == ValueCodec::kRaw) {
+        state.val = ReadBitsWith(peek, pos + consumed, 64);
+        consumed += 64;
+    } else if (!(header >> 63)) {
+        consumed += 1;
+        COMPRESSION_STATS(counters.val_paths[kValPathZeroXor]++);
+    } else {
+        if ((header >> 62) & 1) {
+            state.leading_zeros = (header >> (62 - Policy::kLeadingZeroBits)) & ((1 << Policy::kLeadingZeroBits) - 1);
+            state.meaningful_bits = (header >> (56 - Policy::kLeadingZeroBits)) & 0x3F;
+            if (state.meaningful_bits == 0) {
+                state.meaningful_bits = 64;
+            }
+            if (state.leading_zeros + state.meaningful_bits > 64) {
+                ThrowParsingError("xor window doesn't fit in 64 bits");
+            }
+            consumed += 2 + Policy::kLeadingZeroBits + 6;
+            COMPRESSION_STATS(counters.val_paths[kValPathNewWindow]++);
+        } else {
+            if (state.meaningful_bits == 0) {
+                ThrowParsingError("value reuses the previous xor window, but there is none");
+            }
+            consumed += 2;
+            COMPRESSION_STATS(counters.val_paths[kValPathReuseWindow]++);
+        }
+        std::uint64_t xored_shifted = ReadBitsWith(peek, pos + consumed, state.meaningful_bits);
+        state.val ^= xored_shifted << (64 - state.meaningful_bits - state.leading_zeros);
+        consumed += state.meaningful_bits;
+    }
+    if (pos + consumed > size_bits) {
+        ThrowParsingError("point ends outside of the block, most likely corrupted format");
+    }
+    return pos + consumed;
+}
+
+template <typename Peek>
+inline std::uint64_t DecodePointChecked(const Peek& peek, std::uint64_t pos, std::uint64_t size_bits,
+    TSType start_ts, StreamState& state, BlockCounters& counters) {
+    return DecodePointCheckedWith<GorillaPolicy>(peek, pos, size_bits, start_ts, state, counters);
+}
+
+} // namespace compression
+#endif
@@ -0,0 +1,72 @@
+#include <cstdlib>
+#include <memory>
+#include <vector>
+#include "compression.h"
+
+// libFuzzer target over EncodedDataBlock decoding.
+//
+// By default the input is taken as a serialized block frame. Built with FUZZ_FIX_CHECKSUM the
+// input is taken as a raw stream instead and framed with a correct checksum, so the fuzzer gets
+// past the CRC and exercises the stream validation.
+
+namespace {
+
+using compression::DoubleAsInt;
+using compression::EncodedDataBlock;
+
+#ifdef FUZZ_FIX_CHECKSUM
+std::vector<std::uint8_t> FrameWithChecksum(const std::uint8_t* data, size_t size) {
+    std::vector<std::uint8_t> frame(8);
+    if (size == 0) {
+        return frame;
+    }
+    // The first byte picks how many bits of the last byte are used.
+    std::uint32_t size_bits = (size - 1) * 8;
+    if (size > 1 && data[0] % 8) {
+        size_bits -= 8 - data[0] % 8;
+    }
+    for (int i = 0; i < 4; i++) {
+        frame[i] = (size_bits >> (8 * i)) & 0xFF;
+    }
+    std::uint32_t crc = compression::Crc32(frame.data(), 4);
+    crc = compression::Crc32(data + 1, size - 1, crc);
+    for (int i = 0; i < 4; i++) {
+        frame[4 + i] = (crc >> (8 * i)) & 0xFF;
+    }
+    frame.insert(frame.end(), data + 1, data + size);
+    return frame;
+}
+#endif
+
+} // namespace
+
+extern "C" int LLVMFuzzerTestOneInput(const std::uint8_t* data, size_t size) {
+#ifdef FUZZ_FIX_CHECKSUM
+    auto frame = FrameWithChecksum(data, size);
+#else
+    std::vector<std::uint8_t> frame(data, data + size);
+#endif
+    std::unique_ptr<EncodedDataBlock> block;
+    try {
+        block.reset(EncodedDataBlock::Deserialize(frame.data(), frame.size()));
+    } catch (const compression::ParsingError&) {
+        return 0;
+    }
+
+    // Whatever passed validation has to decode the same with the fast path and the checked iterator,
+    // and serialize back to the same bytes.
+    auto fast = block->Decode();
+    std::vector<std::pair<compression::TSType, compression::ValType>> checked(block->begin(), block->end());
+    if (fast.size() != checked.size()) {
+        std::abort();
+    }
+    for (size_t i = 0; i < fast.size(); i++) {
+        if (fast[i].first != checked[i].first || DoubleAsInt(fast[i].second) != DoubleAsInt(checked[i].second)) {
+            std::abort();
+        }
+    }
+    if (block->Serialize() != frame) {
+        std::abort();
+    }
+    return 0;
+}
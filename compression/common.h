@@ -3,6 +3,7 @@
 
 #include <cinttypes>
 #include <stdexcept>
+#include <string>
 
 namespace compression {
 
@@ -11,6 +12,9 @@ public:
     ParsingError(const std::string& msg): std::logic_error(msg) {}
 };
 
+// Throws ParsingError and counts it in DecodeErrors().
+[[noreturn]] void ThrowParsingError(const std::string& msg);
+
 using TSType = std::uint64_t;
 using ValType = double;
 
@@ -1,56 +1,40 @@
+#include <memory>
 #include <vector>
 #include <utility>
+#include "bit_reader.h"
 #include "compression.h"
-
-#include <map>
+#include "policy.h"
+#include "streaming.h"
+#include "tiering.h"
 
 
 namespace compression {
 
-const int kMaxTimeLengthOfBlockSecs = 2 * 60 * 60;
-
-// Some values appear more than once, so I use multimap.
-std::multimap<int, unsigned int> kLenToSequenceTS = {
-    {1, 0b0},
-    {2, 0b10},
-    {3, 0b110},
-    {4, 0b1110},
-    {4, 0b1111}
-};
-
-std::vector<std::pair<int, unsigned int>> kLenToSequenceVal = {
-    {1, 0b0},
-    {2, 0b10},
-    {2, 0b11},
-};
-
-std::map<int, int> kSequenceToNumBits = {
-    {0b0, 0},
-    {0b10, 7},
-    {0b110, 9},
-    {0b1110, 12},
-    {0b1111, 32}
-};
+const int kMaxTimeLengthOfBlockSecs = GorillaPolicy::kBlockSecs;
+
+// Serialized blocks start with the number of bits and a CRC32 of the bit count and data.
+const int kFrameHeaderBytes = 4 + 4;
 
 TSType AlignTS(TSType timestamp) {
     // 2h blocks aligned to epoch.
-    return timestamp - (timestamp % (2 * 60 * 60));
+    return AlignTSWith<GorillaPolicy>(timestamp);
 }
 
-DataIterator::DataIterator():
- data_(nullptr), byte_offset_(0), bit_offset_(0), current_size_(0) {
+DataIterator::DataIterator(): DataIterator(nullptr, 0, 0) {
  }
 
-DataIterator::DataIterator(std::vector<std::uint8_t>* data):
- data_(data), byte_offset_(0), bit_offset_(0), current_size_(0) {
+DataIterator::DataIterator(std::vector<std::uint8_t>* data): DataIterator(data, 0, 0) {
  }
 
 DataIterator::DataIterator(std::vector<std::uint8_t>* data, int byte_offset, int bit_offset):
- data_(data), byte_offset_(byte_offset), bit_offset_(bit_offset), current_size_(0) {
+ data_(data), byte_offset_(byte_offset), bit_offset_(bit_offset),
+ last_timestamp_(0), last_val_(0), last_delta_(0),
+ last_xor_leading_zeros_(-1), last_xor_meaningful_bits_(-1), current_size_(0) {
  }
 
 DataIterator& DataIterator::DataIterator::operator++() {
     if (byte_offset_ >= data_->size()) {
+        COMPRESSION_STATS(RecordDecodeError());
         throw ParsingError("trying to read outside of data, most likely corrupted format");
     }
     if (current_size_ == 0) {
@@ -63,6 +47,7 @@ DataIterator& DataIterator::DataIterator::operator++() {
 DataIterator DataIterator::operator++(int) {
     DataIterator tmp = *this;
     if (byte_offset_ >= data_->size()) {
+        COMPRESSION_STATS(RecordDecodeError());
         throw ParsingError("trying to read outside of data, most likely corrupted format");
     }
     if (current_size_ == 0) {
@@ -74,6 +59,7 @@ DataIterator DataIterator::operator++(int) {
 
 std::pair<TSType, ValType>& DataIterator::operator*() {
     if (byte_offset_ >= data_->size()) {
+        COMPRESSION_STATS(RecordDecodeError());
         throw ParsingError("trying to read outside of data, most likely corrupted format");
     }
     if (!current_size_) {
@@ -109,7 +95,7 @@ void DataIterator::ReadPair() {
         last_val_ = val;
         last_delta_ = delta;
 
-        current_size_ = 64 + 16 + 64;
+        current_size_ = kBlockHeaderBits;
         current_pair_ = {timestamp, val};
         return;
     }
@@ -120,61 +106,51 @@ void DataIterator::ReadPair() {
     unsigned int byte_offset = byte_offset_;
     int bit_offset = bit_offset_;
 
-    bool matched = false;
-    for (auto p: kLenToSequenceTS) {
-        auto len_of_sequence = p.first;
-        auto sequence = p.second;
-        auto number = ReadBits(len_of_sequence, byte_offset, bit_offset, *data_);
-        if (number == sequence) {
-            matched = true;
-            bit_offset += len_of_sequence;
-            if (bit_offset > 7) {
-                bit_offset -= 8;
-                byte_offset += 1;
-            }
-
-            int num_bits = kSequenceToNumBits[sequence];
-            std::int64_t encoded_delta_of_delta = ReadBits(num_bits, byte_offset, bit_offset, *data_);
-            bit_offset += num_bits;
-            byte_offset += (bit_offset - (bit_offset % 8)) / 8;
-            bit_offset %= 8;
-            if ((encoded_delta_of_delta & (0b1 << (num_bits - 1))) > 0) {
-                encoded_delta_of_delta |= (0xFFFFFFFFFFFFFFFF << num_bits);
-            }
-            delta = last_delta_ + encoded_delta_of_delta;
-            timestamp = last_timestamp_ + delta;
-            last_delta_ = delta;
-            last_timestamp_ = timestamp;
-            break;
-        }
+    // Control sequences are runs of ones ended by a zero, up to 4 for the timestamp and 2
+    // for the value.
+    int leading_ones = 0;
+    while (leading_ones < 4 && ReadBits(1, byte_offset, bit_offset, *data_)) {
+        leading_ones++;
+        bit_offset++;
+        byte_offset += bit_offset / 8;
+        bit_offset %= 8;
     }
-    if (!matched) {
-        throw ParsingError("timestamp couldn't be decoded, sequence not matched");
-    }
-    matched = false;
-    unsigned int number = 0;
-    for (auto p: kLenToSequenceVal) {
-        auto len_of_sequence = p.first;
-        auto sequence = p.second;
-        number = ReadBits(len_of_sequence, byte_offset, bit_offset, *data_);
-        if (number == sequence) {
-            bit_offset += len_of_sequence;
-            if (bit_offset > 7) {
-                bit_offset -= 8;
-                byte_offset += 1;
-            }
-            matched = true;
-            break;
-        }
+    if (leading_ones < 4) {
+        // The terminating zero.
+        bit_offset++;
+        byte_offset += bit_offset / 8;
+        bit_offset %= 8;
     }
-    if (!matched) {
-        throw ParsingError("value couldn't be decoded, sequence not matched");
+    int num_bits = GorillaPolicy::TSDeltaBits(leading_ones);
+    std::int64_t encoded_delta_of_delta = ReadBits(num_bits, byte_offset, bit_offset, *data_);
+    bit_offset += num_bits;
+    byte_offset += bit_offset / 8;
+    bit_offset %= 8;
+    if (num_bits > 0 && (encoded_delta_of_delta & (std::uint64_t(1) << (num_bits - 1))) > 0) {
+        encoded_delta_of_delta |= (0xFFFFFFFFFFFFFFFF << num_bits);
     }
+    delta = last_delta_ + encoded_delta_of_delta;
+    timestamp = last_timestamp_ + delta;
+    last_delta_ = delta;
+    last_timestamp_ = timestamp;
+
+    unsigned int number = ReadBits(1, byte_offset, bit_offset, *data_);
+    bit_offset++;
+    if (number) {
+        number = 2 | ReadBits(1, byte_offset + bit_offset / 8, bit_offset % 8, *data_);
+        bit_offset++;
+    }
+    byte_offset += bit_offset / 8;
+    bit_offset %= 8;
     switch (number) {
         case 0:
             val = last_val_;
             break;
         case 2: {
+            if (last_xor_meaningful_bits_ < 0) {
+                COMPRESSION_STATS(RecordDecodeError());
+                throw ParsingError("value reuses the previous xor window, but there is none");
+            }
             auto xored_shifted = ReadBits(last_xor_meaningful_bits_, byte_offset, bit_offset, *data_);
             bit_offset += last_xor_meaningful_bits_;
             byte_offset += (bit_offset - (bit_offset % 8)) / 8;
@@ -195,6 +171,14 @@ void DataIterator::ReadPair() {
             bit_offset += num_bits;
             byte_offset += (bit_offset - (bit_offset % 8)) / 8;
             bit_offset %= 8;
+            if (meaningful_bits == 0) {
+                meaningful_bits = 64;
+            }
+            if (leading_zeros + meaningful_bits > 64) {
+                COMPRESSION_STATS(RecordDecodeError());
+                throw ParsingError("xor window doesn't fit in 64 bits, leading zeros: " +
+                    std::to_string(leading_zeros) + ", meaningful bits: " + std::to_string(meaningful_bits));
+            }
 
             num_bits = meaningful_bits;
             std::uint64_t xored_shifted = ReadBits(num_bits, byte_offset, bit_offset, *data_);
@@ -210,9 +194,14 @@ void DataIterator::ReadPair() {
             break;
         }
         default:
+            COMPRESSION_STATS(RecordDecodeError());
             throw ParsingError("unknown sequence number while decoding the value " +
                 std::to_string(number));
     }
+    if (byte_offset > data_->size() || (byte_offset == data_->size() && bit_offset > 0)) {
+        COMPRESSION_STATS(RecordDecodeError());
+        throw ParsingError("point ends outside of data, most likely corrupted format");
+    }
     last_val_ = val;
     current_size_ = (byte_offset - byte_offset_) * 8 + bit_offset - bit_offset_;
     current_pair_ = {timestamp, val};
@@ -220,30 +209,20 @@ void DataIterator::ReadPair() {
 
 
 EncodedDataBlock::iterator EncodedDataBlock::begin() {
-    return iterator(&data_);
+    CheckResident();
+    return iterator(&stream_.data);
 }
 
 EncodedDataBlock::iterator EncodedDataBlock::end() {
-    int end_byte_offset = data_end_offset_ ? data_.size() -1: data_.size();
-    return iterator(&data_, end_byte_offset, data_end_offset_);
+    CheckResident();
+    int end_byte_offset = stream_.end_offset ? stream_.data.size() -1: stream_.data.size();
+    return iterator(&stream_.data, end_byte_offset, stream_.end_offset);
 }
 
-EncodedDataBlock::EncodedDataBlock(TSType timestamp, ValType val):
-    last_ts_(timestamp),
-    last_val_(val),
-    last_xor_leading_zeros_(-1), 
-    last_xor_meaningful_bits_(-1),
-    data_end_offset_(0) {
+EncodedDataBlock::EncodedDataBlock(TSType timestamp, ValType val) {
     // Align timestamp to the epoch and figure out what the delta is.
-    auto aligned_ts = AlignTS(timestamp);
-    std::uint16_t delta = timestamp - aligned_ts;
-    last_ts_delta_ = delta;
-    last_ts_ = timestamp;
-    start_ts_ = aligned_ts;
-
-    AppendBits(64, aligned_ts);
-    AppendBits(16, delta);
-    AppendBits(64, DoubleAsInt(val));
+    start_ts_ = AlignTS(timestamp);
+    EncodeHeaderWith<GorillaPolicy>(timestamp, val, ts_state_, val_state_, stream_);
 }
 
 std::uint8_t TailMask(int tail_size) {
@@ -275,19 +254,165 @@ std::uint64_t ReadBits(int num_bits, unsigned int byte_offset, int bit_offset, s
 }
 
 std::uint64_t EncodedDataBlock::ReadBits(int num_bits, unsigned int byte_offset, int bit_offset) {
-    return compression::ReadBits(num_bits, byte_offset, bit_offset, data_);
+    return compression::ReadBits(num_bits, byte_offset, bit_offset, stream_.data);
 }
 
 std::vector<std::pair<TSType, ValType>> EncodedDataBlock::Decode() {
+    CheckResident();
+    // Blocks are either built by Append or validated by Deserialize, so the stream can be
+    // trusted and read without any checks, apart from not loading words past its end.
     std::vector<std::pair<TSType, ValType>> output;
-    std::copy(begin(), end(), std::back_inserter(output));
+    DecodeStreamWith<GorillaPolicy>(stream_, output);
     return output;
 }
 
+std::vector<std::uint8_t> EncodedDataBlock::Serialize() const {
+    CheckResident();
+    std::uint64_t size_bits = SizeInBits();
+    std::vector<std::uint8_t> frame(kFrameHeaderBytes);
+    for (int i = 0; i < 4; i++) {
+        frame[i] = (size_bits >> (8 * i)) & 0xFF;
+    }
+    std::uint32_t crc = Crc32(frame.data(), 4);
+    crc = Crc32(stream_.data.data(), stream_.data.size(), crc);
+    for (int i = 0; i < 4; i++) {
+        frame[4 + i] = (crc >> (8 * i)) & 0xFF;
+    }
+    frame.insert(frame.end(), stream_.data.begin(), stream_.data.end());
+    return frame;
+}
+
+EncodedDataBlock* EncodedDataBlock::Deserialize(const std::uint8_t* frame, size_t size) {
+    if (size < kFrameHeaderBytes) {
+        ThrowParsingError("block frame shorter than its header");
+    }
+    std::uint32_t size_bits = 0;
+    std::uint32_t crc = 0;
+    for (int i = 0; i < 4; i++) {
+        size_bits |= std::uint32_t(frame[i]) << (8 * i);
+        crc |= std::uint32_t(frame[4 + i]) << (8 * i);
+    }
+    if (size - kFrameHeaderBytes != (size_bits + 7) / 8) {
+        ThrowParsingError("block frame of " + std::to_string(size) + " bytes can't hold " +
+            std::to_string(size_bits) + " bits");
+    }
+    // Checked before the stream is parsed, so corrupted frames never get that far.
+    if (Crc32(frame + kFrameHeaderBytes, size - kFrameHeaderBytes, Crc32(frame, 4)) != crc) {
+        ThrowParsingError("block checksum mismatch");
+    }
+
+    return FromBytes(std::vector<std::uint8_t>(frame + kFrameHeaderBytes, frame + size), size_bits);
+}
+
+EncodedDataBlock* EncodedDataBlock::FromBytes(std::vector<std::uint8_t> bytes, std::uint64_t size_bits) {
+    if (bytes.size() != (size_bits + 7) / 8) {
+        ThrowParsingError(std::to_string(bytes.size()) + " bytes can't hold a block of " +
+            std::to_string(size_bits) + " bits");
+    }
+    std::unique_ptr<EncodedDataBlock> block(new EncodedDataBlock());
+    block->stream_.data = std::move(bytes);
+    block->stream_.end_offset = size_bits % 8;
+    block->Validate();
+    return block.release();
+}
+
+void EncodedDataBlock::Validate() {
+    std::uint64_t size_bits = SizeInBits();
+    if (stream_.end_offset && (stream_.data.back() & TailMask(8 - stream_.end_offset))) {
+        ThrowParsingError("block has data after its last bit");
+    }
+    const std::uint8_t* data = stream_.data.data();
+    std::uint64_t size = stream_.data.size();
+    auto peek = [data, size](std::uint64_t pos) { return PeekBitsTail(data, size, pos); };
+
+    StreamState state;
+    start_ts_ = ReadBlockHeaderChecked(peek, size_bits, state);
+    BlockCounters counters;
+    std::uint64_t pos = kBlockHeaderBits;
+    while (pos < size_bits) {
+        pos = DecodePointChecked(peek, pos, size_bits, start_ts_, state, counters);
+    }
+
+    // Pick up where the encoder left off, so the block can still be appended to.
+    ts_state_.last_ts = state.ts;
+    ts_state_.last_ts_delta = state.delta;
+    val_state_.last_val = DoubleFromInt(state.val);
+    val_state_.last_xor_leading_zeros = state.meaningful_bits ? state.leading_zeros : -1;
+    val_state_.last_xor_meaningful_bits = state.meaningful_bits ? state.meaningful_bits : -1;
+    COMPRESSION_STATS(counters_ = counters);
+}
+
 bool EncodedDataBlock::WithinRange(TSType timestamp) {
     return timestamp - start_ts_ < kMaxTimeLengthOfBlockSecs;
 }
 
+bool EncodedDataBlock::Overlaps(TSType from, TSType to) const {
+    return start_ts_ <= to && from < start_ts_ + kMaxTimeLengthOfBlockSecs;
+}
+
+EncoderStats EncodedDataBlock::Stats() const {
+    EncoderStats stats;
+    stats.AddBlock(SizeInBytes(), COMPRESSION_COUNTERS(counters_));
+    return stats;
+}
+
+void EncodedDataBlock::ShrinkToFit() {
+    stream_.data.shrink_to_fit();
+}
+
+std::uint64_t EncodedDataBlock::SizeInBits() const {
+    return IsCold() ? cold_size_bits_ : stream_.SizeInBits();
+}
+
+std::uint64_t EncodedDataBlock::SizeInBytes() const {
+    return (SizeInBits() + 7) / 8;
+}
+
+EncodedDataBlock::~EncodedDataBlock() {
+    if (cold_storage_) {
+        cold_storage_->Release(cold_id_);
+    }
+}
+
+void EncodedDataBlock::CheckResident() const {
+    if (IsCold()) {
+        throw std::logic_error("block is in cold storage, Load() it first");
+    }
+}
+
+void EncodedDataBlock::MoveToColdStorage(ColdStorage& storage) {
+    if (IsCold()) {
+        return;
+    }
+    cold_id_ = storage.Write(*this);
+    cold_size_bits_ = SizeInBits();
+    cold_storage_ = &storage;
+    std::vector<std::uint8_t>().swap(stream_.data);
+}
+
+std::shared_ptr<EncodedDataBlock> EncodedDataBlock::Load() {
+    if (!cold_storage_) {
+        // Not owned, the caller keeps the block alive anyway.
+        return std::shared_ptr<EncodedDataBlock>(std::shared_ptr<EncodedDataBlock>(), this);
+    }
+    return cold_storage_->Read(cold_id_);
+}
+
+std::shared_ptr<const EncodedDataBlock> EncodedDataBlock::Load() const {
+    if (!cold_storage_) {
+        return std::shared_ptr<const EncodedDataBlock>(std::shared_ptr<const EncodedDataBlock>(), this);
+    }
+    return cold_storage_->Read(cold_id_);
+}
+
+std::uint64_t BitStream::SizeInBits() const {
+    std::uint64_t bits = data.size() * 8;
+    if (end_offset) {
+        bits -= 8 - end_offset;
+    }
+    return bits;
+}
+
 std::pair<std::vector<std::uint8_t>, int> BitAppend(int bit_offset, int number_of_bits, std::uint64_t value, std::uint8_t initial_byte) {
     std::vector<std::uint8_t> output;
     std::uint8_t byte = initial_byte;
@@ -307,49 +432,18 @@ std::pair<std::vector<std::uint8_t>, int> BitAppend(int bit_offset, int number_o
     return {output, bit_offset};
 }
 
-void EncodedDataBlock::EncodeTS(TSType timestamp) {
-    int delta = timestamp - last_ts_;
-    int delta_of_delta = delta - last_ts_delta_;
-    last_ts_delta_ = delta;
-    last_ts_ = timestamp;
-    int number_of_bits;
-    std::uint32_t mask;
-    std::uint64_t output = 0;
-    std::uint64_t encoding = 0;
-    if (delta_of_delta == 0) {
-        number_of_bits = 1;
-    } else if (delta_of_delta >= -63 && delta_of_delta <= 64) {
-        encoding = 0b10;
-        mask = 0b1111111;
-        output = encoding << 7 | (delta_of_delta & mask);
-        number_of_bits = 9;
-    } else if (delta_of_delta >= -255 && delta_of_delta <= 256) {
-        encoding = 0b110;
-        mask = 0b111111111;
-        output = encoding << 9 | (delta_of_delta & mask);
-        number_of_bits = 12;
-    } else if (delta_of_delta >= -2047 && delta_of_delta <= 2048) {
-        encoding = 0b1110;
-        mask = 0b111111111111;
-        output = encoding << 12 | (delta_of_delta & mask);
-        number_of_bits = 16;
-    } else {
-        encoding = 0b1111;
-        mask = 0xFFFFFFFF;
-        output = encoding << 32 | (delta_of_delta & mask);
-        number_of_bits = 32 + 4;
-    }
-    AppendBits(number_of_bits, output);
+void EncodeTS(TSType timestamp, TSEncoderState& state, BitStream& stream, BlockCounters& counters) {
+    EncodeTSWith<GorillaPolicy>(timestamp, state, stream, counters);
 }
 
-void EncodedDataBlock::AppendBits(int number_of_bits, std::uint64_t value) {
+void BitStream::AppendBits(int number_of_bits, std::uint64_t value) {
     std::uint8_t initial_byte = 0;
-    if (data_end_offset_ > 0) {
-        initial_byte = data_.back();
-        data_.pop_back();
+    if (end_offset > 0) {
+        initial_byte = data.back();
+        data.pop_back();
     }
 
-    int bit_offset = data_end_offset_;
+    int bit_offset = end_offset;
     std::uint8_t byte = initial_byte;
     while (number_of_bits > 0) {
         int shift = number_of_bits - 8 + bit_offset;
@@ -358,71 +452,245 @@ void EncodedDataBlock::AppendBits(int number_of_bits, std::uint64_t value) {
         } else {
             byte |= (value << -shift) & 0xFF;
         }
-        data_.push_back(byte);
+        data.push_back(byte);
         number_of_bits -= (8 - bit_offset);
         byte = 0;
         bit_offset = 0;
     }
     bit_offset = (8 + number_of_bits) % 8;
-    data_end_offset_ = bit_offset;
+    end_offset = bit_offset;
 }
 
 
-void EncodedDataBlock::EncodeVal(ValType val) {
-    std::uint64_t xored = DoubleAsInt(val) ^ DoubleAsInt(last_val_);
-    if (xored == 0) {
-        AppendBits(1, 0);
-        return;
-    }
-    AppendBits(1, 1);
-
-    int leading_zero_bits = LeadingZeroBits(xored);
-    int trailing_zero_bits = TrailingZeroBits(xored);
-    int meaningful_bits = 64 - leading_zero_bits - trailing_zero_bits;
-
-    if (last_xor_leading_zeros_ != -1 && leading_zero_bits == last_xor_leading_zeros_ &&
-        last_xor_meaningful_bits_ == meaningful_bits) {
-        AppendBits(1, 0);
-        AppendBits(meaningful_bits, TrimToMeaningfulBits(xored, leading_zero_bits, trailing_zero_bits));
-    } else {
-        AppendBits(1, 1);
-        AppendBits(6, leading_zero_bits);
-        AppendBits(6, meaningful_bits);
-        AppendBits(meaningful_bits, TrimToMeaningfulBits(xored, leading_zero_bits, trailing_zero_bits));
-    }
-    last_val_ = val;
-    last_xor_leading_zeros_ = leading_zero_bits;
-    last_xor_meaningful_bits_ = meaningful_bits;
+void EncodeVal(ValType val, ValEncoderState& state, BitStream& stream, BlockCounters& counters) {
+    EncodeValWith<GorillaPolicy>(val, state, stream, counters);
 }
 
 
 void EncodedDataBlock::Append(TSType timestamp, ValType val) {
-    EncodeTS(timestamp);
-    EncodeVal(val);
+    EncodeTS(timestamp, ts_state_, stream_, COMPRESSION_COUNTERS(counters_));
+    EncodeVal(val, val_state_, stream_, COMPRESSION_COUNTERS(counters_));
 }
 
 
 void Encoder::Append(TSType timestamp, ValType val) {
     if (!blocks_.empty()) {
-        auto last_block = blocks_.back();
+        auto last_block = blocks_.back().get();
         if (last_block->WithinRange(timestamp)) {
             last_block->Append(timestamp, val);
+            if (sink_) {
+                SendCompletedBytes(*last_block);
+            }
+            if (retention_.max_bytes && SizeInBytes() > retention_.max_bytes) {
+                EvictToSize(retention_.max_bytes);
+            }
             return;
         }
+        if (sink_) {
+            SendCompletedBytes(*last_block);
+            WriteEndRecord(sink_, kRecordSeal, *last_block);
+            sent_bytes_ = 0;
+        }
+        SealHead();
     }
     auto block = StartNewBlock(timestamp, val);
-    blocks_.push_back(block);
+    blocks_.emplace_back(block);
+    if (sink_) {
+        SendCompletedBytes(*block);
+    }
+    // Blocks only expire when a new one starts, the byte limit may be hit by any point.
+    if (retention_.max_age_secs && timestamp > retention_.max_age_secs) {
+        EvictBefore(timestamp - retention_.max_age_secs);
+    }
+    if (retention_.max_bytes) {
+        EvictToSize(retention_.max_bytes);
+    }
+    if (cold_storage_ && timestamp > hot_secs_) {
+        MoveToColdStorage(timestamp - hot_secs_);
+    }
+}
+
+void Encoder::AppendBlock(EncodedDataBlock* block) {
+    if (!blocks_.empty()) {
+        SealHead();
+    }
+    blocks_.emplace_back(block);
+}
+
+Encoder::Encoder(const RetentionPolicy& retention): retention_(retention) {
+}
+
+void Encoder::SetRetention(const RetentionPolicy& retention) {
+    retention_ = retention;
+}
+
+void Encoder::SealHead() {
+    blocks_.back()->ShrinkToFit();
+    sealed_bytes_ += blocks_.back()->SizeInBytes();
+}
+
+bool Encoder::EvictOldest() {
+    if (blocks_.size() < 2) {
+        return false;
+    }
+    sealed_bytes_ -= blocks_.front()->SizeInBytes();
+    blocks_.pop_front();
+    evicted_blocks_++;
+    return true;
+}
+
+size_t Encoder::EvictBefore(TSType cutoff) {
+    size_t evicted = 0;
+    while (!blocks_.empty() && blocks_.front()->LastTS() < cutoff && EvictOldest()) {
+        evicted++;
+    }
+    return evicted;
+}
+
+size_t Encoder::EvictToSize(std::uint64_t max_bytes) {
+    size_t evicted = 0;
+    while (SizeInBytes() > max_bytes && EvictOldest()) {
+        evicted++;
+    }
+    return evicted;
+}
+
+bool Encoder::OldestEvictable(TSType& start_ts) const {
+    if (blocks_.size() < 2) {
+        return false;
+    }
+    start_ts = blocks_.front()->StartTS();
+    return true;
+}
+
+bool Encoder::LastTS(TSType& timestamp) const {
+    if (blocks_.empty()) {
+        return false;
+    }
+    timestamp = blocks_.back()->LastTS();
+    return true;
+}
+
+std::uint64_t Encoder::SizeInBytes() const {
+    return blocks_.empty() ? 0 : sealed_bytes_ + blocks_.back()->SizeInBytes();
+}
+
+std::uint64_t Encoder::ResidentBytes() const {
+    std::uint64_t bytes = 0;
+    for (auto& block : blocks_) {
+        bytes += block->Bytes().size();
+    }
+    return bytes;
+}
+
+void Encoder::SetColdStorage(ColdStorage* storage, TSType hot_secs) {
+    cold_storage_ = storage;
+    hot_secs_ = hot_secs;
+}
+
+size_t Encoder::MoveToColdStorage(TSType cutoff) {
+    if (!cold_storage_ || blocks_.size() < 2) {
+        return 0;
+    }
+    // Blocks turn cold oldest first, so going back from the newest sealed block the ones to
+    // move end at the first cold or still hot block.
+    size_t end = blocks_.size() - 1;
+    while (end > 0 && blocks_[end - 1]->LastTS() >= cutoff) {
+        end--;
+    }
+    size_t moved = 0;
+    for (size_t i = end; i > 0 && !blocks_[i - 1]->IsCold(); i--) {
+        blocks_[i - 1]->MoveToColdStorage(*cold_storage_);
+        moved++;
+    }
+    return moved;
+}
+
+void Encoder::SetSink(ByteSink sink) {
+    sink_ = std::move(sink);
+    sent_bytes_ = 0;
+    if (!sink_) {
+        return;
+    }
+    // Catch the follower up with everything encoded so far.
+    for (size_t i = 0; i < blocks_.size(); i++) {
+        auto block = blocks_[i]->Load();
+        SendCompletedBytes(*block);
+        if (i + 1 < blocks_.size()) {
+            WriteEndRecord(sink_, kRecordSeal, *block);
+            sent_bytes_ = 0;
+        }
+    }
+}
+
+void Encoder::Flush() {
+    if (!sink_ || blocks_.empty()) {
+        return;
+    }
+    SendCompletedBytes(*blocks_.back());
+    WriteEndRecord(sink_, kRecordCommit, *blocks_.back());
+}
+
+void Encoder::SendCompletedBytes(const EncodedDataBlock& block) {
+    size_t completed = block.Bytes().size() - (block.SizeInBits() % 8 ? 1 : 0);
+    if (completed > sent_bytes_) {
+        WriteDataRecord(sink_, block.Bytes().data() + sent_bytes_, completed - sent_bytes_);
+        sent_bytes_ = completed;
+    }
 }
 
 std::vector<std::pair<TSType, ValType>> Encoder::Decode() {
     std::vector<std::pair<TSType, ValType>> all_ts;
-    for(auto block : blocks_) {
-        auto block_ts = block->Decode();
+    for (auto& block : blocks_) {
+        auto block_ts = block->Load()->Decode();
         all_ts.insert(all_ts.end(), block_ts.begin(), block_ts.end());
     }
     return all_ts;
 }
 
+size_t Encoder::NumBlocks() const {
+    return blocks_.size();
+}
+
+std::vector<std::pair<TSType, ValType>> Encoder::DecodeBlock(size_t block) {
+    return blocks_.at(block)->Load()->Decode();
+}
+
+std::vector<std::pair<TSType, ValType>> Encoder::DecodeRange(TSType from, TSType to) {
+    std::vector<std::pair<TSType, ValType>> points;
+    for (auto& block : blocks_) {
+        if (!block->Overlaps(from, to)) {
+            continue;
+        }
+        // The range-for only keeps the block alive, not the pointer holding the loaded copy.
+        auto loaded = block->Load();
+        for (auto pair : *loaded) {
+            if (pair.first >= from && pair.first <= to) {
+                points.push_back(pair);
+            }
+        }
+    }
+    return points;
+}
+
+EncoderStats Encoder::Stats() const {
+    EncoderStats stats;
+    stats.encoders = 1;
+    stats.evicted_blocks = evicted_blocks_;
+    for (auto& block : blocks_) {
+        stats += block->Stats();
+    }
+    return stats;
+}
+
+std::uint64_t Encoder::SizeInBits() const {
+    std::uint64_t bits = 0;
+    for (auto& block : blocks_) {
+        bits += block->SizeInBits();
+    }
+    return bits;
+}
+
 EncoderIterator Encoder::begin() {
     return iterator(&blocks_);
 }
@@ -431,27 +699,36 @@ EncoderIterator Encoder::end() {
     return iterator(&blocks_, true);
 }
 
-EncoderIterator::EncoderIterator(std::vector<EncodedDataBlock*>* blocks, bool end) :
+EncoderIterator::EncoderIterator(BlockIndex* blocks, bool end) :
 blocks_(blocks) {
-    if (end) {
+    if (blocks_->empty()) {
+        // Nothing to iterate over, begin and end are both the default DataIterator.
+        pos_ = 0;
+    } else if (end) {
+        // The last block is the head, it never goes to cold storage.
         current_block_it_= (*blocks_)[blocks->size() - 1]->end();
         current_block_end_ = current_block_it_;
         pos_ = blocks_->size();
     } else {
-        pos_ = 0;
-        current_block_it_ = (*blocks_)[0]->begin();
-        current_block_end_ = (*blocks_)[0]->end();
+        EnterBlock(0);
     }
 }
 
+void EncoderIterator::EnterBlock(unsigned int pos) {
+    pos_ = pos;
+    current_block_ = (*blocks_)[pos_]->Load();
+    current_block_it_ = current_block_->begin();
+    current_block_end_ = current_block_->end();
+}
 
 EncoderIterator& EncoderIterator::EncoderIterator::operator++() {
     current_block_it_++;
     if (current_block_it_ == current_block_end_) {
-        pos_++;
-        if (pos_ < blocks_->size()) {
-            current_block_it_ = (*blocks_)[pos_]->begin();
-            current_block_end_ = (*blocks_)[pos_]->end();
+        if (pos_ + 1 < blocks_->size()) {
+            EnterBlock(pos_ + 1);
+        } else {
+            pos_++;
+            current_block_.reset();
         }
     }
     return *this;
@@ -459,14 +736,7 @@ EncoderIterator& EncoderIterator::EncoderIterator::operator++() {
 
 EncoderIterator EncoderIterator::operator++(int) {
     EncoderIterator tmp = *this;
-    current_block_it_++;
-    if (current_block_it_ == current_block_end_) {
-        pos_++;
-        if (pos_ < blocks_->size()) {
-            current_block_it_ = (*blocks_)[pos_]->begin();
-            current_block_end_ = (*blocks_)[pos_]->end();
-        }
-    }
+    ++*this;
     return tmp;
 }
 
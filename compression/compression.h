@@ -1,17 +1,28 @@
 #ifndef COMPRESSION_H
 #define COMPRESSION_H
 
+#include <deque>
+#include <functional>
+#include <memory>
 #include <utility>
 #include <vector>
 #include <cinttypes>
 #include "common.h"
 #include "helpers.h"
+#include "stats.h"
 
 namespace compression {
 
 extern const int kMaxTimeLengthOfBlockSecs;
 
+// Start of the block the timestamp belongs to.
+TSType AlignTS(TSType timestamp);
+
+// Receives a byte stream in arbitrary slices, e.g. to replicate encoded data (see streaming.h).
+using ByteSink = std::function<void(const std::uint8_t* data, size_t size)>;
+
 class EncodedDataBlock;
+class ColdStorage;
 
 std::uint64_t ReadBits(int num_bits, unsigned int byte_offset, int bit_offset, std::vector<std::uint8_t>& data);
 
@@ -56,48 +67,132 @@ private:
 };
 
 
+// Bits appended to a byte vector, end_offset is the number of bits used in the last byte, 0 if all.
+struct BitStream {
+    std::vector<std::uint8_t> data;
+    int end_offset = 0;
+
+    void AppendBits(int number_of_bits, std::uint64_t value);
+    std::uint64_t SizeInBits() const;
+};
+
+// What EncodeTS needs to remember about the previous timestamp.
+struct TSEncoderState {
+    TSType last_ts = 0;
+    int last_ts_delta = 0;
+};
+
+// What EncodeVal needs to remember about the previous value.
+struct ValEncoderState {
+    ValType last_val = 0;
+    int last_xor_leading_zeros = -1;
+    int last_xor_meaningful_bits = -1;
+};
+
+// Delta of delta encoding of the timestamp, shared by the block types.
+void EncodeTS(TSType timestamp, TSEncoderState& state, BitStream& stream, BlockCounters& counters);
+// XOR encoding of the value against the previous one, shared by the block types.
+void EncodeVal(ValType val, ValEncoderState& state, BitStream& stream, BlockCounters& counters);
+
 class EncodedDataBlock {
 
 public:
     EncodedDataBlock(TSType timestamp, ValType val);
+    ~EncodedDataBlock();
     using iterator = DataIterator;
 
+    // Iterating, Decode and Serialize need the stream in memory, for cold blocks Load() it first.
     iterator begin();
     iterator end();
 
     bool WithinRange(TSType timestamp);
+    // True if any point in the block could fall between from and to, inclusive.
+    bool Overlaps(TSType from, TSType to) const;
+
+    // Aligned start of the block and the timestamp of its last point.
+    TSType StartTS() const {
+        return start_ts_;
+    }
+    TSType LastTS() const {
+        return ts_state_.last_ts;
+    }
+
+    // Releases the spare capacity of the stream, for blocks which won't grow anymore.
+    void ShrinkToFit();
+
+    // Raw encoded stream, the last byte may be only partially used. Empty for cold blocks.
+    const std::vector<std::uint8_t>& Bytes() const {
+        return stream_.data;
+    }
+    // Number of meaningful bits in the stream, also for cold blocks.
+    std::uint64_t SizeInBits() const;
+    // Bytes of the stream, resident or not.
+    std::uint64_t SizeInBytes() const;
+
+    // Writes the stream to storage and releases it from memory, the metadata stays resident.
+    // storage must outlive the block. Only sealed blocks, which won't be appended to, can move.
+    void MoveToColdStorage(ColdStorage& storage);
+    bool IsCold() const {
+        return cold_storage_ != nullptr;
+    }
+    // The block itself if it's resident, otherwise a copy read back from cold storage (or its
+    // cache), kept alive by the returned pointer.
+    std::shared_ptr<EncodedDataBlock> Load();
+    std::shared_ptr<const EncodedDataBlock> Load() const;
+
+    // Counters of the encoding paths taken, zero when built with COMPRESSION_DISABLE_STATS.
+    EncoderStats Stats() const;
 
     void Append(TSType timestamp, ValType val);
 
     std::vector<std::pair<TSType, ValType>> Decode();
     void PrintBinData() {
-        PrintBin(data_);
+        PrintBin(stream_.data);
     }
 
+    // Frames the block with its length in bits and a CRC32, for storing it on disk or sending it
+    // over the wire.
+    std::vector<std::uint8_t> Serialize() const;
+
+    // Parses a frame produced by Serialize. The checksum and the whole stream are checked once here,
+    // so decoding the returned block needs no further checks. Throws ParsingError if anything is off.
+    // The caller owns the returned block.
+    static EncodedDataBlock* Deserialize(const std::uint8_t* frame, size_t size);
+
+    // Takes over an unframed stream of size_bits bits and validates it like Deserialize.
+    static EncodedDataBlock* FromBytes(std::vector<std::uint8_t> bytes, std::uint64_t size_bits);
+
 private:
+    EncodedDataBlock() = default;
+    void Validate();
+    void CheckResident() const;
+
     // start_ts_ is necessary to check if the next value fits within the block.
-    TSType start_ts_;
+    TSType start_ts_ = 0;
 
     // Make life easier by caching values necessary for encoding next ts, val pair.
-    TSType last_ts_;
-    ValType last_val_;
-    int last_ts_delta_;
-    int last_xor_leading_zeros_;
-    int last_xor_meaningful_bits_;
+    TSEncoderState ts_state_;
+    ValEncoderState val_state_;
 
-    // The actual encrypted data and its offset if the bits are not aligned perfectly from the end.
-    int data_end_offset_;
-    std::vector<std::uint8_t> data_;
+    // The actual encrypted data.
+    BitStream stream_;
+
+    COMPRESSION_STATS(BlockCounters counters_;)
+
+    // Where the stream went, see MoveToColdStorage.
+    ColdStorage* cold_storage_ = nullptr;
+    std::uint64_t cold_id_ = 0;
+    std::uint64_t cold_size_bits_ = 0;
 
-    void AppendBits(int number_of_bits, std::uint64_t value);
-    void EncodeTS(TSType timestamp);
-    void EncodeVal(ValType val);
     std::uint64_t ReadBits(int num_bits, unsigned int byte_offset, int bit_offset);
 };
 
 
 class Encoder;
 
+// Blocks of an Encoder, oldest first, so that expired ones are dropped from the front in O(1).
+using BlockIndex = std::deque<std::unique_ptr<EncodedDataBlock>>;
+
 class EncoderIterator {
 
 public:
@@ -108,7 +203,7 @@ public:
     using pointer = std::pair<TSType, ValType>*;
     using reference = std::pair<TSType, ValType>&;
 
-    EncoderIterator(std::vector<EncodedDataBlock*>* blocks, bool end = false);
+    EncoderIterator(BlockIndex* blocks, bool end = false);
 
     // Dereferencable.
     reference operator*();
@@ -121,12 +216,24 @@ public:
     bool operator!=(const EncoderIterator& rhs);
 
 private:
-    // pos_ points at the current block position.
+    void EnterBlock(unsigned int pos);
+
+    // pos_ points at the current block position, loaded into current_block_ if it's cold.
     unsigned int pos_;
+    std::shared_ptr<EncodedDataBlock> current_block_;
     DataIterator current_block_it_;
     DataIterator current_block_end_;
 
-    std::vector<EncodedDataBlock*>* blocks_;
+    BlockIndex* blocks_;
+};
+
+// Limits on what an Encoder keeps, whole blocks are dropped oldest first. 0 means no limit.
+// The head block, the one being appended to, is never dropped.
+struct RetentionPolicy {
+    // Drop blocks whose points are all more than max_age_secs older than the newest point.
+    TSType max_age_secs = 0;
+    // Drop blocks while the encoded data takes more bytes.
+    std::uint64_t max_bytes = 0;
 };
 
 class Encoder {
@@ -134,20 +241,91 @@ class Encoder {
 public:
     using iterator = EncoderIterator;
 
+    Encoder() = default;
+    explicit Encoder(const RetentionPolicy& retention);
+    // Owns its blocks, so it can be moved but not copied.
+    Encoder(const Encoder&) = delete;
+    Encoder& operator=(const Encoder&) = delete;
+    Encoder(Encoder&&) = default;
+    Encoder& operator=(Encoder&&) = default;
+
     iterator begin();
     iterator end();
 
     void Append(TSType timestamp, ValType val);
 
+    // Adds a complete block after the existing ones and takes ownership of it.
+    void AppendBlock(EncodedDataBlock* block);
+
+    // Streams the encoded data to sink for replication, starting with everything encoded so far.
+    // Completed bytes of the head block are sent as Append produces them, see streaming.h for
+    // the format. An empty sink stops streaming.
+    void SetSink(ByteSink sink);
+    // Sends the partially filled last byte of the head block, so the follower can decode
+    // every point appended so far.
+    void Flush();
+
     std::vector<std::pair<TSType, ValType>> Decode();
+    // Blocks cover up to kMaxTimeLengthOfBlockSecs each, so decoding one at a time bounds the
+    // memory used by a reader regardless of how long the series is.
+    size_t NumBlocks() const;
+    std::vector<std::pair<TSType, ValType>> DecodeBlock(size_t block);
+    // Decodes only the points with timestamps between from and to, inclusive.
+    // Blocks which can't contain such points are skipped without decoding.
+    std::vector<std::pair<TSType, ValType>> DecodeRange(TSType from, TSType to);
+
+    std::uint64_t SizeInBits() const;
+
+    // Bytes of encoded data kept, in O(1). Includes cold blocks, see ResidentBytes.
+    std::uint64_t SizeInBytes() const;
+    // Bytes of encoded data in memory.
+    std::uint64_t ResidentBytes() const;
+
+    // Sum of the stats of all the blocks, add them up across encoders to get a store wide view.
+    EncoderStats Stats() const;
+
+    // Applied on every Append, Evict* can enforce other limits, e.g. from a store wide budget.
+    void SetRetention(const RetentionPolicy& retention);
+    // Drops the blocks older than cutoff, i.e. with the last point before it. Returns how many.
+    size_t EvictBefore(TSType cutoff);
+    // Drops the oldest blocks while SizeInBytes() is over max_bytes. Returns how many.
+    size_t EvictToSize(std::uint64_t max_bytes);
+    // Drops the oldest block, false if only the head block is left.
+    bool EvictOldest();
+    // Start of the oldest block which can be evicted, false if there's none.
+    bool OldestEvictable(TSType& start_ts) const;
+    // Timestamp of the newest point, false if the encoder is empty.
+    bool LastTS(TSType& timestamp) const;
+
+    // Tiering: as new blocks start, sealed blocks with all points more than hot_secs older
+    // than the newest one move to storage, which must outlive the encoder. Reads fault them
+    // back in through the storage cache.
+    void SetColdStorage(ColdStorage* storage, TSType hot_secs);
+    // Moves the sealed blocks older than cutoff to the cold storage now. Returns how many.
+    size_t MoveToColdStorage(TSType cutoff);
 
     void PrintBinData() {
-        for (auto b: blocks_) {
-            b->PrintBinData();
+        for (auto& b: blocks_) {
+            b->Load()->PrintBinData();
         }
     }
 private:
-    std::vector<EncodedDataBlock*> blocks_;
+    BlockIndex blocks_;
+    // Bytes of all the blocks but the head one.
+    std::uint64_t sealed_bytes_ = 0;
+    RetentionPolicy retention_;
+    std::uint64_t evicted_blocks_ = 0;
+    ColdStorage* cold_storage_ = nullptr;
+    TSType hot_secs_ = 0;
+
+    // Makes the head block a sealed one, a new head follows.
+    void SealHead();
+
+    // Replication stream, sent_bytes_ of the head block were already sent to sink_.
+    ByteSink sink_;
+    size_t sent_bytes_ = 0;
+    void SendCompletedBytes(const EncodedDataBlock& block);
+
     EncodedDataBlock* StartNewBlock(TSType timestamp, ValType val) {
         return new EncodedDataBlock(timestamp, val);
     }
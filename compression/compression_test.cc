@@ -1,6 +1,7 @@
 #include <utility>
 #include <vector>
 #include "compression.h"
+#include "workloads.h"
 #include "gtest/gtest.h"
 
 namespace compression {
@@ -134,4 +135,83 @@ TEST(ValEncoding, LeadingZeroes) {
 
  }
 
-} // namespace compression
\ No newline at end of file
+TEST(BlockIterator, IterateOverEmptyEncoder) {
+  compression::Encoder encoder{};
+  EXPECT_TRUE(encoder.begin() == encoder.end());
+  for (auto pair : encoder) {
+    FAIL() << "unexpected point at " << pair.first;
+  }
+}
+
+TEST(TSEncoding, DeltaOfDeltaAtBucketEdges) {
+  compression::Encoder encoder{};
+  std::vector<int> deltas_of_deltas = {
+    63, -64, 64, -65, 255, -256, 256, -257, 2047, -2048, 2048, -2049};
+  std::vector<TSType> timestamps = {2 * 60 * 60 + 3000, 2 * 60 * 60 + 3010};
+  for (auto delta_of_delta : deltas_of_deltas) {
+    auto size = timestamps.size();
+    auto delta = timestamps[size - 1] - timestamps[size - 2];
+    timestamps.push_back(timestamps.back() + delta + delta_of_delta);
+    // Go back to a small delta, so the next one starts from there.
+    timestamps.push_back(timestamps.back() + 10);
+  }
+  for (auto ts : timestamps) {
+    encoder.Append(ts, 1.5);
+  }
+  auto ts_data = encoder.Decode();
+  ASSERT_EQ(timestamps.size(), ts_data.size());
+  for (size_t i = 0; i < timestamps.size(); i++) {
+    EXPECT_EQ(timestamps[i], ts_data[i].first) << i;
+  }
+}
+
+TEST(ValEncoding, AllBitsMeaningful) {
+  // Sign flips with odd mantissas XOR to values without leading and trailing zeros.
+  std::vector<ValType> vals = {
+    1.0000000000000002, -1.0000000000000004, 1.0000000000000002, -3.0000000000000004, 7.5};
+  compression::Encoder encoder{};
+  for (size_t i = 0; i < vals.size(); i++) {
+    encoder.Append(2 * 60 * 60 + i * 10, vals[i]);
+  }
+  auto ts_data = encoder.Decode();
+  ASSERT_EQ(vals.size(), ts_data.size());
+  for (size_t i = 0; i < vals.size(); i++) {
+    EXPECT_EQ(vals[i], ts_data[i].second) << i;
+  }
+}
+
+TEST(Workloads, RoundTrip) {
+  for (auto workload : AllWorkloads()) {
+    auto points = GenerateWorkload(workload, 20000);
+    compression::Encoder encoder{};
+    for (auto pair : points) {
+      encoder.Append(pair.first, pair.second);
+    }
+    EXPECT_EQ(points, encoder.Decode()) << WorkloadName(workload);
+  }
+}
+
+#ifndef COMPRESSION_DISABLE_STATS
+TEST(Workloads, OutagesReachTheWidestBucket) {
+  compression::Encoder encoder{};
+  for (auto pair : GenerateWorkload(Workload::kOutages, 20000)) {
+    encoder.Append(pair.first, pair.second);
+  }
+  EXPECT_GT(encoder.Stats().ts_buckets[kTSBucket32Bits], 0U);
+}
+#endif
+
+TEST(Encoder, DecodeRange) {
+  auto points = GenerateWorkload(Workload::kGaps, 20000);
+  compression::Encoder encoder{};
+  for (auto pair : points) {
+    encoder.Append(pair.first, pair.second);
+  }
+  TSType from = points[5000].first;
+  TSType to = points[12000].first;
+  std::vector<std::pair<TSType, ValType>> expected(points.begin() + 5000, points.begin() + 12001);
+  EXPECT_EQ(expected, encoder.DecodeRange(from, to));
+  EXPECT_TRUE(encoder.DecodeRange(0, points[0].first - 1).empty());
+}
+
+} // namespace compression
@@ -63,4 +63,31 @@ std::uint64_t TrimToMeaningfulBits(std::uint64_t value, int leading_zeros, int t
     return value >> trailing_zeros;
 }
 
-}
\ No newline at end of file
+namespace {
+
+struct Crc32Table {
+    std::uint32_t entries[256];
+
+    Crc32Table() {
+        for (std::uint32_t i = 0; i < 256; i++) {
+            std::uint32_t crc = i;
+            for (int bit = 0; bit < 8; bit++) {
+                crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320 : crc >> 1;
+            }
+            entries[i] = crc;
+        }
+    }
+};
+
+} // namespace
+
+std::uint32_t Crc32(const std::uint8_t* data, size_t size, std::uint32_t crc) {
+    static const Crc32Table table;
+    crc = ~crc;
+    for (size_t i = 0; i < size; i++) {
+        crc = table.entries[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+}
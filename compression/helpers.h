@@ -20,6 +20,9 @@ ValType DoubleFromInt(std::uint64_t int_encoded);
 int LeadingZeroBits(std::uint64_t val);
 int TrailingZeroBits(std::uint64_t val);
 
+// CRC-32 (IEEE), pass the previous result as crc to checksum data in pieces.
+std::uint32_t Crc32(const std::uint8_t* data, size_t size, std::uint32_t crc = 0);
+
 std::uint64_t TrimToMeaningfulBits(std::uint64_t value, int leading_zeros, int trailing_zeros);
 
 } // namespace compression
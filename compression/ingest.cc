@@ -0,0 +1,222 @@
+#include <functional>
+#include <sstream>
+#include <stdexcept>
+#include "ingest.h"
+
+namespace compression {
+
+namespace {
+
+// Rounds a worker polls its empty queue before it goes to sleep.
+const int kIdleSpins = 64;
+
+} // namespace
+
+std::string IngestStats::ToText(const std::string& prefix) const {
+    std::ostringstream out;
+    out << "# TYPE " << prefix << "_applied_total counter\n";
+    out << prefix << "_applied_total " << applied << "\n";
+    out << "# TYPE " << prefix << "_dropped_total counter\n";
+    out << prefix << "_dropped_total " << dropped << "\n";
+    out << "# TYPE " << prefix << "_full_queue_total counter\n";
+    out << prefix << "_full_queue_total " << full_queue << "\n";
+    out << "# TYPE " << prefix << "_batches_total counter\n";
+    out << prefix << "_batches_total " << batches << "\n";
+    return out.str();
+}
+
+IngestPipeline::IngestPipeline(const IngestOptions& options): options_(options) {
+    size_t num_workers = options_.num_workers;
+    if (!num_workers) {
+        num_workers = std::thread::hardware_concurrency();
+        num_workers = num_workers ? num_workers : 1;
+    }
+    if (!options_.queue_capacity || !options_.batch_size) {
+        throw std::invalid_argument("ingest queues and batches need room for a sample");
+    }
+    for (size_t i = 0; i < num_workers; i++) {
+        partitions_.emplace_back(new Partition(options_.queue_capacity, options_.per_series));
+    }
+    for (auto& partition : partitions_) {
+        Partition* p = partition.get();
+        partition->worker = std::thread([this, p] { Run(*p); });
+    }
+}
+
+IngestPipeline::~IngestPipeline() {
+    Stop();
+}
+
+size_t IngestPipeline::PartitionOf(const std::string& series) const {
+    return std::hash<std::string>()(series) % partitions_.size();
+}
+
+SeriesHandle IngestPipeline::Intern(const std::string& series) {
+    SeriesHandle handle;
+    handle.partition = PartitionOf(series);
+    Partition& partition = *partitions_[handle.partition];
+    {
+        std::shared_lock<std::shared_timed_mutex> lock(partition.names_mutex);
+        auto it = partition.ids.find(series);
+        if (it != partition.ids.end()) {
+            handle.id = it->second;
+            return handle;
+        }
+    }
+    std::unique_lock<std::shared_timed_mutex> lock(partition.names_mutex);
+    auto it = partition.ids.emplace(series, partition.names.size()).first;
+    if (it->second == partition.names.size()) {
+        partition.names.push_back(series);
+    }
+    handle.id = it->second;
+    return handle;
+}
+
+bool IngestPipeline::Append(const std::string& series, TSType timestamp, ValType val) {
+    return Append(Intern(series), timestamp, val);
+}
+
+bool IngestPipeline::Append(SeriesHandle series, TSType timestamp, ValType val) {
+    if (stopping_.load(std::memory_order_relaxed)) {
+        throw std::logic_error("appending to a stopped ingest pipeline");
+    }
+    if (series.partition >= partitions_.size()) {
+        throw std::invalid_argument("series handle of another ingest pipeline");
+    }
+    Partition& partition = *partitions_[series.partition];
+    Sample sample{series.id, timestamp, val};
+    if (!partition.queue.TryPush(sample)) {
+        partition.full_queue.fetch_add(1, std::memory_order_relaxed);
+        if (options_.backpressure == Backpressure::kDrop) {
+            partition.dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        while (!partition.queue.TryPush(sample)) {
+            // A full queue has a busy worker, it doesn't need waking.
+            std::this_thread::yield();
+        }
+    }
+    Wake(partition);
+    return true;
+}
+
+void IngestPipeline::Wake(Partition& partition) {
+    // Pairs with the fence in Run: either the worker sees the sample before it sleeps, or
+    // this sees it sleeping.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (partition.sleeping.load(std::memory_order_relaxed)) {
+        std::lock_guard<std::mutex> lock(partition.wake_mutex);
+        partition.wake.notify_one();
+    }
+}
+
+Encoder& IngestPipeline::EncoderOf(Partition& partition, std::uint32_t series) {
+    if (series >= partition.encoders.size()) {
+        partition.encoders.resize(series + 1, nullptr);
+    }
+    if (!partition.encoders[series]) {
+        // Names are never changed once added, only the deque holding them needs the lock.
+        const std::string* name;
+        {
+            std::shared_lock<std::shared_timed_mutex> lock(partition.names_mutex);
+            name = &partition.names[series];
+        }
+        partition.encoders[series] = &partition.store.FindOrAdd(*name);
+    }
+    return *partition.encoders[series];
+}
+
+void IngestPipeline::Run(Partition& partition) {
+    std::vector<Sample> batch;
+    batch.reserve(options_.batch_size);
+    int idle = 0;
+    while (true) {
+        batch.clear();
+        if (partition.queue.PopBatch(batch, options_.batch_size)) {
+            idle = 0;
+            std::lock_guard<std::mutex> lock(partition.store_mutex);
+            for (auto& sample : batch) {
+                EncoderOf(partition, sample.series).Append(sample.timestamp, sample.val);
+            }
+            partition.applied.fetch_add(batch.size(), std::memory_order_release);
+            partition.batches.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+        if (stopping_.load(std::memory_order_acquire) && partition.queue.Empty()) {
+            return;
+        }
+        if (++idle < kIdleSpins) {
+            std::this_thread::yield();
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(partition.wake_mutex);
+        partition.sleeping.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (partition.queue.Empty() && !stopping_.load(std::memory_order_relaxed)) {
+            partition.wake.wait(lock);
+        }
+        partition.sleeping.store(false, std::memory_order_relaxed);
+        idle = 0;
+    }
+}
+
+void IngestPipeline::Flush() {
+    for (auto& partition : partitions_) {
+        size_t queued = partition->queue.Claimed();
+        while (partition->applied.load(std::memory_order_acquire) < queued) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+void IngestPipeline::Stop() {
+    if (stopping_.exchange(true)) {
+        return;
+    }
+    for (auto& partition : partitions_) {
+        std::lock_guard<std::mutex> lock(partition->wake_mutex);
+        partition->wake.notify_one();
+    }
+    for (auto& partition : partitions_) {
+        partition->worker.join();
+    }
+}
+
+size_t IngestPipeline::NumSeries() const {
+    size_t series = 0;
+    for (auto& partition : partitions_) {
+        std::lock_guard<std::mutex> lock(partition->store_mutex);
+        series += partition->store.NumSeries();
+    }
+    return series;
+}
+
+std::vector<std::pair<TSType, ValType>> IngestPipeline::Decode(const std::string& series) const {
+    Partition& partition = *partitions_[PartitionOf(series)];
+    std::lock_guard<std::mutex> lock(partition.store_mutex);
+    Encoder* encoder = partition.store.Find(series);
+    return encoder ? encoder->Decode() : std::vector<std::pair<TSType, ValType>>();
+}
+
+IngestStats IngestPipeline::Stats() const {
+    IngestStats stats;
+    for (auto& partition : partitions_) {
+        stats.applied += partition->applied.load(std::memory_order_relaxed);
+        stats.dropped += partition->dropped.load(std::memory_order_relaxed);
+        stats.full_queue += partition->full_queue.load(std::memory_order_relaxed);
+        stats.batches += partition->batches.load(std::memory_order_relaxed);
+    }
+    return stats;
+}
+
+EncoderStats IngestPipeline::StoreStats() const {
+    EncoderStats stats;
+    for (auto& partition : partitions_) {
+        std::lock_guard<std::mutex> lock(partition->store_mutex);
+        stats += partition->store.Stats();
+    }
+    return stats;
+}
+
+} // namespace compression
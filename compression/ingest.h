@@ -0,0 +1,247 @@
+#ifndef COMPRESSION_INGEST_H
+#define COMPRESSION_INGEST_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <cinttypes>
+#include "common.h"
+#include "compression.h"
+#include "stats.h"
+#include "store.h"
+
+namespace compression {
+
+// Bounded lock-free queue for many producer threads and a single consumer thread.
+//
+// Every slot carries a sequence number telling whose turn it is: producers claim a position
+// with a CAS on tail_ and publish the slot by bumping its sequence, the consumer takes
+// published slots in order and hands them back for the next lap (D. Vyukov's bounded queue).
+// A producer stalled between claiming and publishing holds back the consumer at its slot.
+template <typename T>
+class MpscRing {
+
+public:
+    // capacity is rounded up to a power of two.
+    explicit MpscRing(size_t capacity) {
+        size_t size = 1;
+        while (size < capacity) {
+            size <<= 1;
+        }
+        mask_ = size - 1;
+        slots_.reset(new Slot[size]);
+        for (size_t i = 0; i < size; i++) {
+            slots_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    size_t Capacity() const {
+        return mask_ + 1;
+    }
+
+    // Leaves value alone and returns false if the ring is full. Any thread.
+    bool TryPush(T& value) {
+        size_t pos = tail_.load(std::memory_order_relaxed);
+        Slot* slot;
+        while (true) {
+            slot = &slots_[pos & mask_];
+            size_t sequence = slot->sequence.load(std::memory_order_acquire);
+            std::intptr_t diff = static_cast<std::intptr_t>(sequence) - static_cast<std::intptr_t>(pos);
+            if (diff == 0) {
+                if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                // The slot of the previous lap wasn't taken yet.
+                return false;
+            } else {
+                pos = tail_.load(std::memory_order_relaxed);
+            }
+        }
+        slot->value = std::move(value);
+        slot->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Moves up to max published items to the back of out and returns how many. Consumer only.
+    size_t PopBatch(std::vector<T>& out, size_t max) {
+        size_t popped = 0;
+        while (popped < max) {
+            Slot& slot = slots_[head_ & mask_];
+            if (slot.sequence.load(std::memory_order_acquire) != head_ + 1) {
+                break;
+            }
+            out.push_back(std::move(slot.value));
+            slot.sequence.store(head_ + mask_ + 1, std::memory_order_release);
+            head_++;
+            popped++;
+        }
+        return popped;
+    }
+
+    // True if the next slot isn't published yet. Consumer only.
+    bool Empty() const {
+        return slots_[head_ & mask_].sequence.load(std::memory_order_acquire) != head_ + 1;
+    }
+
+    // Positions claimed by producers so far, published or not.
+    size_t Claimed() const {
+        return tail_.load(std::memory_order_acquire);
+    }
+
+private:
+    struct Slot {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    size_t mask_;
+    std::unique_ptr<Slot[]> slots_;
+    // Producers and the consumer write these, the padding keeps them on their own cache lines.
+    char tail_padding_[64];
+    std::atomic<size_t> tail_{0};
+    char head_padding_[64];
+    size_t head_ = 0;
+};
+
+// What Append does when the queue of the series' partition is full.
+enum class Backpressure {
+    // Waits for the worker to make room, producers slow down to the ingestion rate.
+    kBlock,
+    // Drops the sample and returns false, producers never wait.
+    kDrop,
+};
+
+struct IngestOptions {
+    // Partitions, each with its worker thread and queue. 0 means one per core.
+    size_t num_workers = 0;
+    // Samples per partition queue.
+    size_t queue_capacity = 1 << 16;
+    // Most samples a worker appends under one lock of its partition.
+    size_t batch_size = 256;
+    Backpressure backpressure = Backpressure::kBlock;
+    // Retention of every series, enforced by its encoder.
+    RetentionPolicy per_series;
+};
+
+struct IngestStats {
+    // Samples in the encoders, dropped by Backpressure::kDrop and the Append calls which found
+    // the queue full.
+    std::uint64_t applied = 0;
+    std::uint64_t dropped = 0;
+    std::uint64_t full_queue = 0;
+    // Batches the workers appended, applied / batches is the average batch size.
+    std::uint64_t batches = 0;
+
+    // Prometheus text exposition format, metric names start with prefix.
+    std::string ToText(const std::string& prefix = "compression_ingest") const;
+};
+
+// A series interned by IngestPipeline::Intern, valid for the pipeline that returned it.
+struct SeriesHandle {
+    std::uint32_t partition = 0;
+    // Index of the series within its partition.
+    std::uint32_t id = 0;
+};
+
+// Takes samples from any number of threads and appends them to per series encoders.
+//
+// Series are split into partitions by the hash of their name. Every partition is owned by a
+// worker thread, which is the only one appending to its encoders, so they need no locking.
+// Producers hand samples over through the MpscRing of the partition and the worker drains it
+// in batches. An idle worker sleeps until the next sample arrives. Samples carry the interned
+// series, so queueing one neither hashes nor copies the name.
+class IngestPipeline {
+
+public:
+    explicit IngestPipeline(const IngestOptions& options = IngestOptions());
+    // Stops the workers after they appended everything queued.
+    ~IngestPipeline();
+    IngestPipeline(const IngestPipeline&) = delete;
+    IngestPipeline& operator=(const IngestPipeline&) = delete;
+
+    // The handle of the series, the same for every call with the name. From any thread, cheap
+    // once the series is known, producers should still keep the handles of their series.
+    SeriesHandle Intern(const std::string& series);
+
+    // Queues the sample for its series, from any thread. Returns false if it was dropped,
+    // see Backpressure. Throws std::logic_error after Stop and std::invalid_argument for a
+    // handle this pipeline didn't return.
+    bool Append(SeriesHandle series, TSType timestamp, ValType val);
+    // Interns the series for every sample, see Intern.
+    bool Append(const std::string& series, TSType timestamp, ValType val);
+
+    // Waits until the samples queued before the call are in the encoders.
+    void Flush();
+    // Appends what's queued and joins the workers. Producers have to be done by then.
+    void Stop();
+
+    size_t NumWorkers() const {
+        return partitions_.size();
+    }
+    size_t NumSeries() const;
+    // Points of the series appended so far, empty if it has none. Waits for the current batch
+    // of the series' worker.
+    std::vector<std::pair<TSType, ValType>> Decode(const std::string& series) const;
+
+    IngestStats Stats() const;
+    // Stats of the encoders of all the series.
+    EncoderStats StoreStats() const;
+
+private:
+    struct Sample {
+        std::uint32_t series;
+        TSType timestamp;
+        ValType val;
+    };
+
+    struct Partition {
+        explicit Partition(size_t capacity, const RetentionPolicy& per_series):
+            queue(capacity), store(per_series) {}
+
+        MpscRing<Sample> queue;
+
+        // Interned names, a deque so they stay put while others are added. Read by the worker
+        // when it meets a series for the first time.
+        std::shared_timed_mutex names_mutex;
+        std::unordered_map<std::string, std::uint32_t> ids;
+        std::deque<std::string> names;
+
+        // Held by the worker while it appends a batch, and by readers.
+        mutable std::mutex store_mutex;
+        SeriesStore store;
+        // Encoders of the store by series id, only touched by the worker.
+        std::vector<Encoder*> encoders;
+        std::atomic<std::uint64_t> applied{0};
+        std::atomic<std::uint64_t> batches{0};
+        std::atomic<std::uint64_t> dropped{0};
+        std::atomic<std::uint64_t> full_queue{0};
+
+        // Sleeping worker, woken by producers that see sleeping set.
+        std::mutex wake_mutex;
+        std::condition_variable wake;
+        std::atomic<bool> sleeping{false};
+        std::thread worker;
+    };
+
+    size_t PartitionOf(const std::string& series) const;
+    // The encoder of an interned series of the partition. Worker only, under store_mutex.
+    Encoder& EncoderOf(Partition& partition, std::uint32_t series);
+    void Run(Partition& partition);
+    void Wake(Partition& partition);
+
+    IngestOptions options_;
+    std::vector<std::unique_ptr<Partition>> partitions_;
+    std::atomic<bool> stopping_{false};
+};
+
+} // namespace compression
+#endif
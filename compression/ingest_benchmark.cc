@@ -0,0 +1,154 @@
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "ingest.h"
+#include "store.h"
+
+// Sustained ingestion from many producer threads. Every iteration starts the producers, lets
+// each append kPointsPerProducer points round robin over its series and waits until all of them
+// are in the encoders. items_per_second is the sustained rate, p99_enqueue_ns the 99th
+// percentile of a single Append call as the producers see it. Series are named like scraped
+// Prometheus series, far past the short string buffer. BM_Ingest appends through handles the
+// producers interned up front or by name, BM_MutexStore is the baseline: the producers append
+// to one SeriesStore behind a mutex.
+
+namespace {
+
+const int kPointsPerProducer = 1 << 16;
+const int kSeriesPerProducer = 64;
+// Every how many Append calls a producer times one.
+const int kLatencySampling = 16;
+
+std::vector<std::string> SeriesNames(int producer) {
+    std::vector<std::string> names;
+    for (int s = 0; s < kSeriesPerProducer; s++) {
+        names.push_back("node_cpu_seconds_total{instance=\"host-" + std::to_string(producer) +
+            ".prod.example.com:9100\",cpu=\"" + std::to_string(s) + "\",mode=\"user\"}");
+    }
+    return names;
+}
+
+// Runs producers threads of produce(producer, latencies) and returns all the latencies.
+template <typename Produce>
+std::vector<double> RunProducers(int producers, Produce produce) {
+    std::vector<std::vector<double>> latencies(producers);
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; p++) {
+        threads.emplace_back([&produce, &latencies, p] { produce(p, latencies[p]); });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    std::vector<double> all;
+    for (auto& producer : latencies) {
+        all.insert(all.end(), producer.begin(), producer.end());
+    }
+    return all;
+}
+
+template <typename Series, typename AppendFn>
+void Produce(const std::vector<Series>& series_of_producer, std::vector<double>& latencies, AppendFn append) {
+    latencies.reserve(kPointsPerProducer / kLatencySampling);
+    for (int i = 0; i < kPointsPerProducer; i++) {
+        const Series& series = series_of_producer[i % kSeriesPerProducer];
+        compression::TSType timestamp = 1000 + (i / kSeriesPerProducer) * 10;
+        if (i % kLatencySampling) {
+            append(series, timestamp, i);
+            continue;
+        }
+        auto start = std::chrono::steady_clock::now();
+        append(series, timestamp, i);
+        auto end = std::chrono::steady_clock::now();
+        latencies.push_back(std::chrono::duration<double, std::nano>(end - start).count());
+    }
+}
+
+double Percentile(std::vector<double>& latencies, double percentile) {
+    if (latencies.empty()) {
+        return 0;
+    }
+    size_t rank = static_cast<size_t>(percentile * (latencies.size() - 1));
+    std::nth_element(latencies.begin(), latencies.begin() + rank, latencies.end());
+    return latencies[rank];
+}
+
+// Args: producer threads, workers, 0 for Backpressure::kBlock or 1 for kDrop and 0 to append
+// through SeriesHandles or 1 by name.
+void BM_Ingest(benchmark::State& state) {
+    int producers = state.range(0);
+    compression::IngestOptions options;
+    options.num_workers = state.range(1);
+    options.queue_capacity = 1 << 12;
+    options.backpressure = state.range(2) ? compression::Backpressure::kDrop : compression::Backpressure::kBlock;
+    bool by_name = state.range(3);
+    std::vector<std::vector<std::string>> names;
+    for (int p = 0; p < producers; p++) {
+        names.push_back(SeriesNames(p));
+    }
+
+    std::vector<double> latencies;
+    std::uint64_t applied = 0;
+    std::uint64_t dropped = 0;
+    for (auto _ : state) {
+        compression::IngestPipeline pipeline(options);
+        auto run = RunProducers(producers, [&](int p, std::vector<double>& out) {
+            auto append = [&pipeline](const auto& series, compression::TSType timestamp, compression::ValType val) {
+                pipeline.Append(series, timestamp, val);
+            };
+            if (by_name) {
+                Produce(names[p], out, append);
+                return;
+            }
+            std::vector<compression::SeriesHandle> handles;
+            for (auto& name : names[p]) {
+                handles.push_back(pipeline.Intern(name));
+            }
+            Produce(handles, out, append);
+        });
+        pipeline.Flush();
+        latencies.insert(latencies.end(), run.begin(), run.end());
+        applied += pipeline.Stats().applied;
+        dropped += pipeline.Stats().dropped;
+    }
+    state.SetItemsProcessed(applied);
+    state.counters["p99_enqueue_ns"] = Percentile(latencies, 0.99);
+    state.counters["dropped_fraction"] = static_cast<double>(dropped) / (applied + dropped);
+}
+
+// Args: producer threads.
+void BM_MutexStore(benchmark::State& state) {
+    int producers = state.range(0);
+    std::vector<std::vector<std::string>> names;
+    for (int p = 0; p < producers; p++) {
+        names.push_back(SeriesNames(p));
+    }
+
+    std::vector<double> latencies;
+    for (auto _ : state) {
+        compression::SeriesStore store;
+        std::mutex mutex;
+        auto run = RunProducers(producers, [&](int p, std::vector<double>& out) {
+            Produce(names[p], out, [&store, &mutex](const std::string& series, compression::TSType timestamp, compression::ValType val) {
+                std::lock_guard<std::mutex> lock(mutex);
+                store.Append(series, timestamp, val);
+            });
+        });
+        latencies.insert(latencies.end(), run.begin(), run.end());
+    }
+    state.SetItemsProcessed(state.iterations() * producers * kPointsPerProducer);
+    state.counters["p99_enqueue_ns"] = Percentile(latencies, 0.99);
+}
+
+} // namespace
+
+BENCHMARK(BM_Ingest)
+    ->Args({1, 1, 0, 0})->Args({4, 1, 0, 0})->Args({4, 2, 0, 0})->Args({8, 4, 0, 0})
+    ->Args({4, 1, 1, 0})->Args({8, 4, 1, 0})
+    ->Args({1, 1, 0, 1})->Args({8, 4, 0, 1})
+    ->UseRealTime()->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_MutexStore)->Arg(1)->Arg(4)->Arg(8)->UseRealTime()->Unit(benchmark::kMillisecond);
@@ -0,0 +1,199 @@
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "ingest.h"
+#include "gtest/gtest.h"
+
+namespace compression {
+
+TEST(MpscRing, RoundsUpAndFillsUp) {
+  MpscRing<int> ring(5);
+  EXPECT_EQ(8u, ring.Capacity());
+  EXPECT_TRUE(ring.Empty());
+  for (int i = 0; i < 8; i++) {
+    ASSERT_TRUE(ring.TryPush(i));
+  }
+  int extra = 8;
+  EXPECT_FALSE(ring.TryPush(extra));
+  EXPECT_EQ(8, extra);
+  EXPECT_EQ(8u, ring.Claimed());
+
+  std::vector<int> out;
+  EXPECT_EQ(3u, ring.PopBatch(out, 3));
+  EXPECT_TRUE(ring.TryPush(extra));
+  EXPECT_EQ(6u, ring.PopBatch(out, 100));
+  EXPECT_TRUE(ring.Empty());
+  EXPECT_EQ(std::vector<int>({0, 1, 2, 3, 4, 5, 6, 7, 8}), out);
+}
+
+TEST(MpscRing, ManyProducersKeepTheirOrder) {
+  const int kProducers = 4;
+  const int kItems = 5000;
+  MpscRing<int> ring(64);
+  std::vector<std::thread> producers;
+  for (int p = 0; p < kProducers; p++) {
+    producers.emplace_back([&ring, p] {
+      for (int i = 0; i < kItems; i++) {
+        int item = p * kItems + i;
+        while (!ring.TryPush(item)) {
+          std::this_thread::yield();
+        }
+      }
+    });
+  }
+  std::vector<int> out;
+  std::vector<int> last(kProducers, -1);
+  size_t taken = 0;
+  while (taken < kProducers * kItems) {
+    out.clear();
+    size_t popped = ring.PopBatch(out, 16);
+    if (!popped) {
+      std::this_thread::yield();
+    }
+    taken += popped;
+    for (int item : out) {
+      int p = item / kItems;
+      ASSERT_LT(last[p], item % kItems);
+      last[p] = item % kItems;
+    }
+  }
+  for (auto& producer : producers) {
+    producer.join();
+  }
+  EXPECT_TRUE(ring.Empty());
+}
+
+TEST(Ingest, ConcurrentProducers) {
+  IngestOptions options;
+  options.num_workers = 3;
+  options.queue_capacity = 128;
+  options.batch_size = 32;
+  IngestPipeline pipeline(options);
+  EXPECT_EQ(3u, pipeline.NumWorkers());
+
+  // Every producer owns its series, so their points arrive in order.
+  const int kProducers = 4;
+  const int kSeries = 10;
+  const int kPoints = 2000;
+  std::vector<std::thread> producers;
+  for (int p = 0; p < kProducers; p++) {
+    producers.emplace_back([&pipeline, p] {
+      for (int i = 0; i < kPoints; i++) {
+        for (int s = 0; s < kSeries; s++) {
+          pipeline.Append("p" + std::to_string(p) + ".s" + std::to_string(s), 1000 + i * 10, i + s);
+        }
+      }
+    });
+  }
+  for (auto& producer : producers) {
+    producer.join();
+  }
+  pipeline.Flush();
+
+  EXPECT_EQ(static_cast<size_t>(kProducers * kSeries), pipeline.NumSeries());
+  for (int p = 0; p < kProducers; p++) {
+    for (int s = 0; s < kSeries; s++) {
+      auto points = pipeline.Decode("p" + std::to_string(p) + ".s" + std::to_string(s));
+      ASSERT_EQ(static_cast<size_t>(kPoints), points.size());
+      for (int i = 0; i < kPoints; i++) {
+        ASSERT_EQ(1000 + i * 10, points[i].first);
+        ASSERT_EQ(i + s, points[i].second);
+      }
+    }
+  }
+  EXPECT_TRUE(pipeline.Decode("missing").empty());
+
+  IngestStats stats = pipeline.Stats();
+  EXPECT_EQ(static_cast<std::uint64_t>(kProducers * kSeries * kPoints), stats.applied);
+  EXPECT_EQ(0u, stats.dropped);
+  EXPECT_GT(stats.batches, 0u);
+#ifndef COMPRESSION_DISABLE_STATS
+  EXPECT_EQ(stats.applied, pipeline.StoreStats().points);
+#endif
+}
+
+TEST(Ingest, InternedSeries) {
+  IngestOptions options;
+  options.num_workers = 2;
+  IngestPipeline pipeline(options);
+  const std::string name = "node_cpu_seconds_total{instance=\"host-017.prod.example.com:9100\",mode=\"user\"}";
+  SeriesHandle handle = pipeline.Intern(name);
+  SeriesHandle again = pipeline.Intern(name);
+  EXPECT_EQ(handle.partition, again.partition);
+  EXPECT_EQ(handle.id, again.id);
+  SeriesHandle other = pipeline.Intern("other");
+  EXPECT_FALSE(other.partition == handle.partition && other.id == handle.id);
+
+  // Handles and names reach the same encoder.
+  for (int i = 0; i < 100; i++) {
+    EXPECT_TRUE(i % 2 ? pipeline.Append(handle, i * 10, i) : pipeline.Append(name, i * 10, i));
+  }
+  pipeline.Flush();
+  auto points = pipeline.Decode(name);
+  ASSERT_EQ(100u, points.size());
+  EXPECT_EQ(990u, points.back().first);
+  EXPECT_EQ(1u, pipeline.NumSeries());
+
+  SeriesHandle foreign;
+  foreign.partition = 7;
+  EXPECT_THROW(pipeline.Append(foreign, 0, 0), std::invalid_argument);
+}
+
+TEST(Ingest, DropWhenFull) {
+  IngestOptions options;
+  options.num_workers = 1;
+  options.queue_capacity = 2;
+  options.batch_size = 1;
+  options.backpressure = Backpressure::kDrop;
+  IngestPipeline pipeline(options);
+
+  const int kPoints = 100000;
+  int accepted = 0;
+  for (int i = 0; i < kPoints; i++) {
+    accepted += pipeline.Append("series", i, i);
+  }
+  pipeline.Flush();
+
+  IngestStats stats = pipeline.Stats();
+  EXPECT_EQ(static_cast<std::uint64_t>(accepted), stats.applied);
+  EXPECT_EQ(static_cast<std::uint64_t>(kPoints - accepted), stats.dropped);
+  EXPECT_EQ(stats.dropped, stats.full_queue);
+  EXPECT_EQ(static_cast<size_t>(accepted), pipeline.Decode("series").size());
+}
+
+TEST(Ingest, StopAppendsWhatIsQueued) {
+  IngestOptions options;
+  options.num_workers = 2;
+  IngestPipeline pipeline(options);
+  for (int i = 0; i < 5000; i++) {
+    pipeline.Append("a", i, i);
+    pipeline.Append("b", i, -i);
+  }
+  pipeline.Stop();
+  pipeline.Stop();
+  EXPECT_EQ(5000u, pipeline.Decode("a").size());
+  EXPECT_EQ(5000u, pipeline.Decode("b").size());
+  EXPECT_THROW(pipeline.Append("a", 5000, 0), std::logic_error);
+}
+
+TEST(Ingest, RejectsEmptyQueues) {
+  IngestOptions options;
+  options.queue_capacity = 0;
+  EXPECT_THROW(IngestPipeline pipeline(options), std::invalid_argument);
+}
+
+TEST(Ingest, StatsText) {
+  IngestStats stats;
+  stats.applied = 10;
+  stats.dropped = 2;
+  stats.full_queue = 3;
+  stats.batches = 4;
+  std::string text = stats.ToText("ingest");
+  EXPECT_NE(std::string::npos, text.find("# TYPE ingest_applied_total counter\ningest_applied_total 10\n"));
+  EXPECT_NE(std::string::npos, text.find("ingest_dropped_total 2\n"));
+  EXPECT_NE(std::string::npos, text.find("ingest_full_queue_total 3\n"));
+  EXPECT_NE(std::string::npos, text.find("ingest_batches_total 4\n"));
+}
+
+} // namespace compression
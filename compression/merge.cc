@@ -0,0 +1,278 @@
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+#include "merge.h"
+
+namespace compression {
+
+// Stream of merged points ordered by timestamp, current is valid after Advance returned true.
+class MergeSource {
+
+public:
+    virtual ~MergeSource() = default;
+    virtual bool Advance() = 0;
+
+    MergedPoint current;
+};
+
+namespace {
+
+// Points the shard threads hand over at once, so the queues are locked once per batch.
+const size_t kBatchPoints = 512;
+
+// A single series, one point per step. Blocks are decoded one at a time with the fast decoder,
+// so at most one block of points per series is held.
+class SeriesSource : public MergeSource {
+
+public:
+    SeriesSource(Encoder* encoder, TSType step): encoder_(encoder), step_(step) {}
+
+    bool Advance() override {
+        if (!Fill()) {
+            return false;
+        }
+        current.timestamp = Align(points_[next_].first);
+        ValType val;
+        do {
+            val = points_[next_++].second;
+        } while (Fill() && Align(points_[next_].first) == current.timestamp);
+        current.state = AggregateState();
+        current.state.Add(val);
+        return true;
+    }
+
+private:
+    TSType Align(TSType timestamp) const {
+        return timestamp - timestamp % step_;
+    }
+
+    // Makes sure points_[next_] is valid, false at the end of the series.
+    bool Fill() {
+        while (next_ == points_.size()) {
+            if (block_ == encoder_->NumBlocks()) {
+                return false;
+            }
+            points_ = encoder_->DecodeBlock(block_++);
+            next_ = 0;
+        }
+        return true;
+    }
+
+    Encoder* encoder_;
+    TSType step_;
+    size_t block_ = 0;
+    std::vector<std::pair<TSType, ValType>> points_;
+    size_t next_ = 0;
+};
+
+// Partial aggregates of a shard merged on another thread.
+class QueueSource : public MergeSource {
+
+public:
+    QueueSource(BoundedQueue<std::vector<MergedPoint>>& queue, const std::exception_ptr& error):
+        queue_(queue), error_(error) {}
+
+    bool Advance() override {
+        if (next_ == batch_.size()) {
+            next_ = 0;
+            if (!queue_.Pop(batch_)) {
+                batch_.clear();
+                if (error_) {
+                    std::rethrow_exception(error_);
+                }
+                return false;
+            }
+        }
+        current = batch_[next_++];
+        return true;
+    }
+
+private:
+    BoundedQueue<std::vector<MergedPoint>>& queue_;
+    const std::exception_ptr& error_;
+    std::vector<MergedPoint> batch_;
+    size_t next_ = 0;
+};
+
+bool Later(const MergeSource* a, const MergeSource* b) {
+    return a->current.timestamp > b->current.timestamp;
+}
+
+// Restores the heap after the top source moved on, about half the comparisons of pop_heap
+// followed by push_heap.
+void SiftDownTop(std::vector<MergeSource*>& heap) {
+    size_t size = heap.size();
+    size_t i = 0;
+    MergeSource* top = heap[0];
+    while (true) {
+        size_t child = 2 * i + 1;
+        if (child >= size) {
+            break;
+        }
+        if (child + 1 < size && Later(heap[child], heap[child + 1])) {
+            child++;
+        }
+        if (!Later(top, heap[child])) {
+            break;
+        }
+        heap[i] = heap[child];
+        i = child;
+    }
+    heap[i] = top;
+}
+
+} // namespace
+
+void AggregateState::Add(ValType val) {
+    count++;
+    sum += val;
+    min = std::min(min, val);
+    max = std::max(max, val);
+}
+
+AggregateState& AggregateState::operator+=(const AggregateState& other) {
+    count += other.count;
+    sum += other.sum;
+    min = std::min(min, other.min);
+    max = std::max(max, other.max);
+    return *this;
+}
+
+ValType AggregateState::Result(Aggregation aggregation) const {
+    switch (aggregation) {
+    case Aggregation::kSum:
+        return sum;
+    case Aggregation::kAvg:
+        return sum / count;
+    case Aggregation::kMax:
+        return max;
+    case Aggregation::kMin:
+        return min;
+    }
+    return sum;
+}
+
+MergeIterator::MergeIterator(const std::vector<Encoder*>& series, Aggregation aggregation, TSType step):
+    aggregation_(aggregation) {
+    if (step == 0) {
+        throw std::invalid_argument("merge step has to be positive");
+    }
+    for (auto encoder : series) {
+        sources_.emplace_back(new SeriesSource(encoder, step));
+    }
+}
+
+MergeIterator::MergeIterator(std::vector<std::unique_ptr<MergeSource>> sources, Aggregation aggregation):
+    aggregation_(aggregation), sources_(std::move(sources)) {
+}
+
+MergeIterator::~MergeIterator() = default;
+
+void MergeIterator::Start() {
+    started_ = true;
+    for (auto& source : sources_) {
+        if (source->Advance()) {
+            heap_.push_back(source.get());
+        }
+    }
+    std::make_heap(heap_.begin(), heap_.end(), Later);
+}
+
+bool MergeIterator::Next(MergedPoint& point) {
+    if (!started_) {
+        Start();
+    }
+    if (heap_.empty()) {
+        return false;
+    }
+    point.timestamp = heap_.front()->current.timestamp;
+    point.state = AggregateState();
+    while (!heap_.empty() && heap_.front()->current.timestamp == point.timestamp) {
+        MergeSource* source = heap_.front();
+        point.state += source->current.state;
+        if (!source->Advance()) {
+            heap_.front() = heap_.back();
+            heap_.pop_back();
+            if (heap_.empty()) {
+                break;
+            }
+        }
+        SiftDownTop(heap_);
+    }
+    return true;
+}
+
+bool MergeIterator::Next(std::pair<TSType, ValType>& point) {
+    MergedPoint merged;
+    if (!Next(merged)) {
+        return false;
+    }
+    point = {merged.timestamp, merged.state.Result(aggregation_)};
+    return true;
+}
+
+ParallelMergeIterator::ParallelMergeIterator(const std::vector<std::vector<Encoder*>>& shards,
+    Aggregation aggregation, TSType step, size_t queue_batches) {
+    if (step == 0) {
+        throw std::invalid_argument("merge step has to be positive");
+    }
+    if (queue_batches == 0) {
+        throw std::invalid_argument("shard queues need room for a batch");
+    }
+    std::vector<std::unique_ptr<MergeSource>> sources;
+    try {
+        for (auto& series : shards) {
+            shards_.emplace_back(new Shard(queue_batches));
+            Shard* shard = shards_.back().get();
+            sources.emplace_back(new QueueSource(shard->queue, shard->error));
+            shard->thread = std::thread([shard, series, aggregation, step] {
+                try {
+                    MergeIterator merge(series, aggregation, step);
+                    std::vector<MergedPoint> batch;
+                    MergedPoint point;
+                    while (merge.Next(point)) {
+                        batch.push_back(point);
+                        if (batch.size() == kBatchPoints) {
+                            if (!shard->queue.Push(std::move(batch))) {
+                                break;
+                            }
+                            batch.clear();
+                        }
+                    }
+                    if (!batch.empty()) {
+                        shard->queue.Push(std::move(batch));
+                    }
+                } catch (...) {
+                    shard->error = std::current_exception();
+                }
+                shard->queue.Close();
+            });
+        }
+    } catch (...) {
+        Stop();
+        throw;
+    }
+    merge_.reset(new MergeIterator(std::move(sources), aggregation));
+}
+
+ParallelMergeIterator::~ParallelMergeIterator() {
+    Stop();
+}
+
+void ParallelMergeIterator::Stop() {
+    for (auto& shard : shards_) {
+        shard->queue.Close();
+    }
+    for (auto& shard : shards_) {
+        if (shard->thread.joinable()) {
+            shard->thread.join();
+        }
+    }
+}
+
+bool ParallelMergeIterator::Next(std::pair<TSType, ValType>& point) {
+    return merge_->Next(point);
+}
+
+} // namespace compression
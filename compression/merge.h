@@ -0,0 +1,158 @@
+#ifndef COMPRESSION_MERGE_H
+#define COMPRESSION_MERGE_H
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <cinttypes>
+#include "common.h"
+#include "compression.h"
+
+// Query time merge of many series into one, e.g. sum by (cluster).
+//
+// The series are decoded a block at a time and merged with a heap ordered by timestamp, so
+// memory grows with the number of series, not with the length of the queried range.
+
+namespace compression {
+
+enum class Aggregation {
+    kSum,
+    kAvg,
+    kMax,
+    kMin,
+};
+
+// Values merged into one timestamp so far, partial states of disjoint series add up with +=.
+struct AggregateState {
+    std::uint64_t count = 0;
+    ValType sum = 0;
+    ValType min = std::numeric_limits<ValType>::infinity();
+    ValType max = -std::numeric_limits<ValType>::infinity();
+
+    void Add(ValType val);
+    AggregateState& operator+=(const AggregateState& other);
+    ValType Result(Aggregation aggregation) const;
+};
+
+struct MergedPoint {
+    TSType timestamp;
+    AggregateState state;
+};
+
+class MergeSource;
+
+// Merges the series on the calling thread. Timestamps are rounded down to a multiple of step,
+// so series scraped at different offsets line up, and within a step only the last point of
+// each series counts. The encoders must outlive the iterator and not change while it's used.
+class MergeIterator {
+
+public:
+    MergeIterator(const std::vector<Encoder*>& series, Aggregation aggregation, TSType step = 1);
+    ~MergeIterator();
+
+    // Sets point to the next timestamp and its aggregate, returns false once all series ended.
+    bool Next(std::pair<TSType, ValType>& point);
+    // Same, keeping the state to be merged further.
+    bool Next(MergedPoint& point);
+
+private:
+    friend class ParallelMergeIterator;
+    MergeIterator(std::vector<std::unique_ptr<MergeSource>> sources, Aggregation aggregation);
+
+    // Sources are read from the first Next, so that errors are thrown from there.
+    void Start();
+
+    Aggregation aggregation_;
+    bool started_ = false;
+    // Min-heap of the sources which have a point, ordered by their timestamps.
+    std::vector<std::unique_ptr<MergeSource>> sources_;
+    std::vector<MergeSource*> heap_;
+};
+
+// Queue between a producer and a consumer thread, Push blocks while it holds capacity items.
+// Close ends the stream on both sides: Pop returns false once the queue is empty and Push
+// drops the item and returns false.
+template <typename T>
+class BoundedQueue {
+
+public:
+    explicit BoundedQueue(size_t capacity): capacity_(capacity) {}
+
+    bool Push(T item) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        not_full_.wait(lock, [this] { return closed_ || items_.size() < capacity_; });
+        if (closed_) {
+            return false;
+        }
+        items_.push_back(std::move(item));
+        not_empty_.notify_one();
+        return true;
+    }
+
+    bool Pop(T& item) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        not_empty_.wait(lock, [this] { return closed_ || !items_.empty(); });
+        if (items_.empty()) {
+            return false;
+        }
+        item = std::move(items_.front());
+        items_.pop_front();
+        not_full_.notify_one();
+        return true;
+    }
+
+    void Close() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closed_ = true;
+        not_full_.notify_all();
+        not_empty_.notify_all();
+    }
+
+private:
+    size_t capacity_;
+    bool closed_ = false;
+    std::deque<T> items_;
+    std::mutex mutex_;
+    std::condition_variable not_full_;
+    std::condition_variable not_empty_;
+};
+
+// MergeIterator over shards of series, each shard is merged on its own thread and the
+// partial aggregates are merged again on the calling thread. Shards hand over batches of
+// points through bounded queues, so a slow consumer holds back the threads instead of
+// piling up results. Errors from a shard, e.g. ParsingError, are rethrown by Next.
+class ParallelMergeIterator {
+
+public:
+    // Every shard queue holds up to queue_batches batches. Throws std::invalid_argument if step
+    // or queue_batches is 0.
+    ParallelMergeIterator(const std::vector<std::vector<Encoder*>>& shards, Aggregation aggregation,
+        TSType step = 1, size_t queue_batches = 16);
+    // Stops and joins the shard threads, also when the merge wasn't read to the end.
+    ~ParallelMergeIterator();
+
+    bool Next(std::pair<TSType, ValType>& point);
+
+private:
+    void Stop();
+
+    struct Shard {
+        BoundedQueue<std::vector<MergedPoint>> queue;
+        std::exception_ptr error;
+        std::thread thread;
+
+        explicit Shard(size_t capacity): queue(capacity) {}
+    };
+
+    std::vector<std::unique_ptr<Shard>> shards_;
+    std::unique_ptr<MergeIterator> merge_;
+};
+
+} // namespace compression
+#endif
@@ -0,0 +1,86 @@
+#include <map>
+#include <vector>
+#include <utility>
+
+#include "benchmark/benchmark.h"
+#include "compression.h"
+#include "merge.h"
+#include "workloads.h"
+
+// sum over a fleet of series: decoding everything into a map, the single threaded merge and
+// the merge over 4 shards. items_per_second counts input points.
+
+namespace {
+
+const int kNumPoints = 2000;
+
+std::vector<compression::Encoder>& Fleet(int num_series) {
+    static std::map<int, std::vector<compression::Encoder>> fleets;
+    auto& series = fleets[num_series];
+    if (series.empty()) {
+        series.resize(num_series);
+        for (int i = 0; i < num_series; i++) {
+            for (auto& pair : compression::GenerateWorkload(compression::Workload::kJittered, kNumPoints, i + 1)) {
+                series[i].Append(pair.first, pair.second);
+            }
+        }
+    }
+    return series;
+}
+
+std::vector<compression::Encoder*> Pointers(std::vector<compression::Encoder>& series) {
+    std::vector<compression::Encoder*> pointers;
+    for (auto& encoder : series) {
+        pointers.push_back(&encoder);
+    }
+    return pointers;
+}
+
+} // namespace
+
+static void BM_SumDecodeAll(benchmark::State& state) {
+    auto& series = Fleet(state.range(0));
+    for (auto _ : state) {
+        std::map<compression::TSType, compression::ValType> sums;
+        for (auto& encoder : series) {
+            for (auto& pair : encoder.Decode()) {
+                sums[pair.first - pair.first % 10] += pair.second;
+            }
+        }
+        benchmark::DoNotOptimize(sums.size());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0) * kNumPoints);
+}
+BENCHMARK(BM_SumDecodeAll)->Arg(16)->Arg(256)->Unit(benchmark::kMillisecond);
+
+static void BM_SumMerge(benchmark::State& state) {
+    auto series = Pointers(Fleet(state.range(0)));
+    for (auto _ : state) {
+        compression::MergeIterator merge(series, compression::Aggregation::kSum, 10);
+        std::pair<compression::TSType, compression::ValType> point;
+        while (merge.Next(point)) {
+            benchmark::DoNotOptimize(point);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0) * kNumPoints);
+}
+BENCHMARK(BM_SumMerge)->Arg(16)->Arg(256)->Unit(benchmark::kMillisecond);
+
+static void BM_SumParallelMerge(benchmark::State& state) {
+    auto series = Pointers(Fleet(state.range(0)));
+    std::vector<std::vector<compression::Encoder*>> shards(4);
+    for (size_t i = 0; i < series.size(); i++) {
+        shards[i % shards.size()].push_back(series[i]);
+    }
+    for (auto _ : state) {
+        compression::ParallelMergeIterator merge(shards, compression::Aggregation::kSum, 10);
+        std::pair<compression::TSType, compression::ValType> point;
+        while (merge.Next(point)) {
+            benchmark::DoNotOptimize(point);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0) * kNumPoints);
+}
+BENCHMARK(BM_SumParallelMerge)->Arg(16)->Arg(256)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+BENCHMARK_MAIN();
@@ -0,0 +1,162 @@
+#include <cmath>
+#include <map>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+#include "compression.h"
+#include "merge.h"
+#include "workloads.h"
+#include "gtest/gtest.h"
+
+namespace compression {
+
+namespace {
+
+using Points = std::vector<std::pair<TSType, ValType>>;
+
+// Decodes everything and aggregates with a map, the way queries did it before.
+Points Reference(std::vector<Encoder>& series, Aggregation aggregation, TSType step) {
+  std::map<TSType, AggregateState> merged;
+  for (auto& encoder : series) {
+    std::map<TSType, ValType> last;
+    for (auto& pair : encoder.Decode()) {
+      last[pair.first - pair.first % step] = pair.second;
+    }
+    for (auto& pair : last) {
+      merged[pair.first].Add(pair.second);
+    }
+  }
+  Points points;
+  for (auto& pair : merged) {
+    points.push_back({pair.first, pair.second.Result(aggregation)});
+  }
+  return points;
+}
+
+template <typename Iterator>
+Points ReadAll(Iterator& it) {
+  Points points;
+  std::pair<TSType, ValType> point;
+  while (it.Next(point)) {
+    points.push_back(point);
+  }
+  return points;
+}
+
+// Sums are added up in a different order than in Reference, so they can differ in the last bits.
+void ExpectSamePoints(const Points& expected, const Points& points) {
+  ASSERT_EQ(expected.size(), points.size());
+  for (size_t i = 0; i < points.size(); i++) {
+    ASSERT_EQ(expected[i].first, points[i].first);
+    ASSERT_NEAR(expected[i].second, points[i].second, 1e-9 * std::fabs(expected[i].second));
+  }
+}
+
+std::vector<Encoder> Fleet(int num_series, int num_points) {
+  std::vector<Encoder> series(num_series);
+  for (int i = 0; i < num_series; i++) {
+    auto workload = AllWorkloads()[i % AllWorkloads().size()];
+    for (auto& pair : GenerateWorkload(workload, num_points, i + 1)) {
+      series[i].Append(pair.first, pair.second);
+    }
+  }
+  return series;
+}
+
+std::vector<Encoder*> Pointers(std::vector<Encoder>& series) {
+  std::vector<Encoder*> pointers;
+  for (auto& encoder : series) {
+    pointers.push_back(&encoder);
+  }
+  return pointers;
+}
+
+} // namespace
+
+TEST(Merge, AggregatesPerTimestamp) {
+  std::vector<Encoder> series(3);
+  series[0].Append(100, 1);
+  series[0].Append(110, 2);
+  series[1].Append(100, 10);
+  series[1].Append(120, 20);
+  series[2].Append(110, -5);
+  series[2].Append(120, 4);
+
+  MergeIterator sum(Pointers(series), Aggregation::kSum);
+  EXPECT_EQ(Points({{100, 11}, {110, -3}, {120, 24}}), ReadAll(sum));
+  MergeIterator avg(Pointers(series), Aggregation::kAvg);
+  EXPECT_EQ(Points({{100, 5.5}, {110, -1.5}, {120, 12}}), ReadAll(avg));
+  MergeIterator max(Pointers(series), Aggregation::kMax);
+  EXPECT_EQ(Points({{100, 10}, {110, 2}, {120, 20}}), ReadAll(max));
+  MergeIterator min(Pointers(series), Aggregation::kMin);
+  EXPECT_EQ(Points({{100, 1}, {110, -5}, {120, 4}}), ReadAll(min));
+}
+
+TEST(Merge, AlignsToStep) {
+  std::vector<Encoder> series(2);
+  series[0].Append(100, 1);
+  series[0].Append(103, 2);
+  series[0].Append(111, 3);
+  series[1].Append(107, 10);
+  series[1].Append(118, 20);
+
+  // The last point of a series within the step counts.
+  MergeIterator sum(Pointers(series), Aggregation::kSum, 10);
+  EXPECT_EQ(Points({{100, 12}, {110, 23}}), ReadAll(sum));
+  EXPECT_THROW(MergeIterator(Pointers(series), Aggregation::kSum, 0), std::invalid_argument);
+}
+
+TEST(Merge, SkipsEmptySeries) {
+  std::vector<Encoder> series(3);
+  series[1].Append(100, 1);
+  MergeIterator sum(Pointers(series), Aggregation::kSum);
+  EXPECT_EQ(Points({{100, 1}}), ReadAll(sum));
+
+  MergeIterator none(std::vector<Encoder*>(), Aggregation::kSum);
+  EXPECT_TRUE(ReadAll(none).empty());
+}
+
+TEST(Merge, MatchesReference) {
+  auto series = Fleet(20, 3000);
+  for (auto aggregation : {Aggregation::kSum, Aggregation::kAvg, Aggregation::kMax, Aggregation::kMin}) {
+    for (TSType step : {1, 10, 60}) {
+      MergeIterator merge(Pointers(series), aggregation, step);
+      ExpectSamePoints(Reference(series, aggregation, step), ReadAll(merge));
+    }
+  }
+}
+
+TEST(ParallelMerge, MatchesSingleThreaded) {
+  auto series = Fleet(40, 3000);
+  auto pointers = Pointers(series);
+  std::vector<std::vector<Encoder*>> shards(4);
+  for (size_t i = 0; i < pointers.size(); i++) {
+    shards[i % shards.size()].push_back(pointers[i]);
+  }
+  shards.push_back({});
+
+  for (auto aggregation : {Aggregation::kSum, Aggregation::kAvg, Aggregation::kMax, Aggregation::kMin}) {
+    MergeIterator merge(pointers, aggregation, 10);
+    // A single batch in flight per shard, so the threads keep blocking on the queues.
+    ParallelMergeIterator parallel(shards, aggregation, 10, 1);
+    ExpectSamePoints(ReadAll(merge), ReadAll(parallel));
+  }
+}
+
+TEST(ParallelMerge, StopsWhenNotReadToTheEnd) {
+  auto series = Fleet(8, 20000);
+  auto pointers = Pointers(series);
+  std::vector<std::vector<Encoder*>> shards = {
+    {pointers.begin(), pointers.begin() + 4}, {pointers.begin() + 4, pointers.end()}};
+  ParallelMergeIterator parallel(shards, Aggregation::kSum, 1, 1);
+  std::pair<TSType, ValType> point;
+  EXPECT_TRUE(parallel.Next(point));
+}
+
+TEST(ParallelMerge, RejectsEmptyQueues) {
+  auto series = Fleet(2, 100);
+  std::vector<std::vector<Encoder*>> shards = {Pointers(series)};
+  EXPECT_THROW(ParallelMergeIterator(shards, Aggregation::kSum, 1, 0), std::invalid_argument);
+}
+
+} // namespace compression
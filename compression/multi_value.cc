@@ -0,0 +1,210 @@
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+#include "bit_reader.h"
+#include "multi_value.h"
+
+namespace compression {
+
+namespace {
+
+void CheckColumns(size_t expected, const std::vector<ValType>& vals) {
+    if (vals.size() != expected) {
+        throw std::invalid_argument("expected " + std::to_string(expected) + " values, got " +
+            std::to_string(vals.size()));
+    }
+}
+
+// Calls step(peek, pos) from pos until the end of the stream. Like EncodedDataBlock::Decode,
+// words are loaded directly while they are far enough from the end.
+template <typename Step>
+void ScanStream(const BitStream& stream, std::uint64_t pos, Step step) {
+    const std::uint8_t* data = stream.data.data();
+    std::uint64_t size = stream.data.size();
+    auto peek = [data](std::uint64_t pos) { return PeekBits(data, pos); };
+    auto peek_tail = [data, size](std::uint64_t pos) { return PeekBitsTail(data, size, pos); };
+
+    std::uint64_t end = stream.SizeInBits();
+    std::uint64_t fast_end = size * 8 > kDecodePointReach ? size * 8 - kDecodePointReach : 0;
+    while (pos < fast_end) {
+        pos = step(peek, pos);
+    }
+    while (pos < end) {
+        pos = step(peek_tail, pos);
+    }
+}
+
+} // namespace
+
+MultiValueBlock::MultiValueBlock(TSType timestamp, const std::vector<ValType>& vals):
+    val_states_(vals.size()), columns_(vals.size()) {
+    start_ts_ = AlignTSWith<GorillaPolicy>(timestamp);
+    EncodeTSHeaderWith<GorillaPolicy>(timestamp, ts_state_, timestamps_);
+
+    for (size_t i = 0; i < vals.size(); i++) {
+        val_states_[i].last_val = vals[i];
+        columns_[i].AppendBits(64, DoubleAsInt(vals[i]));
+    }
+}
+
+bool MultiValueBlock::WithinRange(TSType timestamp) {
+    return timestamp - start_ts_ < static_cast<TSType>(kMaxTimeLengthOfBlockSecs);
+}
+
+bool MultiValueBlock::Overlaps(TSType from, TSType to) const {
+    return start_ts_ <= to && from < start_ts_ + kMaxTimeLengthOfBlockSecs;
+}
+
+void MultiValueBlock::Append(TSType timestamp, const std::vector<ValType>& vals) {
+    CheckColumns(columns_.size(), vals);
+    EncodeTS(timestamp, ts_state_, timestamps_, COMPRESSION_COUNTERS(counters_));
+    for (size_t i = 0; i < vals.size(); i++) {
+        EncodeVal(vals[i], val_states_[i], columns_[i], COMPRESSION_COUNTERS(counters_));
+    }
+}
+
+void MultiValueBlock::CheckColumn(size_t column) const {
+    if (column >= columns_.size()) {
+        throw std::out_of_range("column " + std::to_string(column) + " out of range");
+    }
+}
+
+template <typename Emit>
+void MultiValueBlock::ScanTimestamps(Emit emit) const {
+    auto peek_tail = [this](std::uint64_t pos) {
+        return PeekBitsTail(timestamps_.data.data(), timestamps_.data.size(), pos);
+    };
+    StreamState state;
+    state.delta = ReadBitsWith(peek_tail, 64, GorillaPolicy::kHeaderDeltaBits);
+    state.ts = ReadBitsWith(peek_tail, 0, 64) + state.delta;
+    emit(state.ts);
+    ScanStream(timestamps_, 64 + GorillaPolicy::kHeaderDeltaBits, [&emit, &state](const auto& peek, std::uint64_t pos) {
+        pos = DecodeTimestamp(peek, pos, state);
+        emit(state.ts);
+        return pos;
+    });
+}
+
+template <typename Emit>
+void MultiValueBlock::ScanColumn(size_t column, Emit emit) const {
+    const BitStream& stream = columns_[column];
+    auto peek_tail = [&stream](std::uint64_t pos) {
+        return PeekBitsTail(stream.data.data(), stream.data.size(), pos);
+    };
+    StreamState state;
+    state.val = ReadBitsWith(peek_tail, 0, 64);
+    emit(DoubleFromInt(state.val));
+    ScanStream(stream, 64, [&emit, &state](const auto& peek, std::uint64_t pos) {
+        pos = DecodeValue(peek, pos, state);
+        emit(DoubleFromInt(state.val));
+        return pos;
+    });
+}
+
+std::vector<TSType> MultiValueBlock::DecodeTimestamps() const {
+    std::vector<TSType> output;
+    ScanTimestamps([&output](TSType ts) { output.push_back(ts); });
+    return output;
+}
+
+std::vector<ValType> MultiValueBlock::DecodeColumn(size_t column) const {
+    CheckColumn(column);
+    std::vector<ValType> output;
+    ScanColumn(column, [&output](ValType val) { output.push_back(val); });
+    return output;
+}
+
+void MultiValueBlock::DecodeColumn(size_t column, std::vector<std::pair<TSType, ValType>>& points) const {
+    CheckColumn(column);
+    size_t first = points.size();
+    ScanTimestamps([&points](TSType ts) { points.push_back({ts, 0}); });
+    auto it = points.begin() + first;
+    ScanColumn(column, [&it](ValType val) { (it++)->second = val; });
+}
+
+void MultiValueBlock::DecodeRows(std::vector<Row>& rows) const {
+    size_t first = rows.size();
+    ScanTimestamps([this, &rows](TSType ts) {
+        rows.push_back({ts, {}});
+        rows.back().second.reserve(columns_.size());
+    });
+    for (size_t column = 0; column < columns_.size(); column++) {
+        auto it = rows.begin() + first;
+        ScanColumn(column, [&it](ValType val) { (it++)->second.push_back(val); });
+    }
+}
+
+std::vector<Row> MultiValueBlock::DecodeRows() const {
+    std::vector<Row> rows;
+    DecodeRows(rows);
+    return rows;
+}
+
+std::uint64_t MultiValueBlock::SizeInBits() const {
+    std::uint64_t bits = timestamps_.SizeInBits();
+    for (auto& column : columns_) {
+        bits += column.SizeInBits();
+    }
+    return bits;
+}
+
+EncoderStats MultiValueBlock::Stats() const {
+    std::uint64_t bytes = timestamps_.data.size();
+    for (auto& column : columns_) {
+        bytes += column.data.size();
+    }
+    EncoderStats stats;
+    stats.AddBlock(bytes, COMPRESSION_COUNTERS(counters_));
+    return stats;
+}
+
+MultiValueEncoder::MultiValueEncoder(size_t num_columns): num_columns_(num_columns) {
+}
+
+void MultiValueEncoder::Append(TSType timestamp, const std::vector<ValType>& vals) {
+    CheckColumns(num_columns_, vals);
+    if (!blocks_.empty() && blocks_.back().WithinRange(timestamp)) {
+        blocks_.back().Append(timestamp, vals);
+        return;
+    }
+    blocks_.emplace_back(timestamp, vals);
+}
+
+std::vector<Row> MultiValueEncoder::DecodeRows() const {
+    std::vector<Row> rows;
+    for (auto& block : blocks_) {
+        block.DecodeRows(rows);
+    }
+    return rows;
+}
+
+std::vector<std::pair<TSType, ValType>> MultiValueEncoder::DecodeColumn(size_t column) const {
+    if (column >= num_columns_) {
+        throw std::out_of_range("column " + std::to_string(column) + " out of range");
+    }
+    std::vector<std::pair<TSType, ValType>> points;
+    for (auto& block : blocks_) {
+        block.DecodeColumn(column, points);
+    }
+    return points;
+}
+
+std::uint64_t MultiValueEncoder::SizeInBits() const {
+    std::uint64_t bits = 0;
+    for (auto& block : blocks_) {
+        bits += block.SizeInBits();
+    }
+    return bits;
+}
+
+EncoderStats MultiValueEncoder::Stats() const {
+    EncoderStats stats;
+    stats.encoders = 1;
+    for (auto& block : blocks_) {
+        stats += block.Stats();
+    }
+    return stats;
+}
+
+} // namespace compression
@@ -0,0 +1,99 @@
+#ifndef COMPRESSION_MULTI_VALUE_H
+#define COMPRESSION_MULTI_VALUE_H
+
+#include <utility>
+#include <vector>
+#include <cinttypes>
+#include "common.h"
+#include "compression.h"
+#include "stats.h"
+
+namespace compression {
+
+// One row: the shared timestamp and a value per column.
+using Row = std::pair<TSType, std::vector<ValType>>;
+
+// Block of several series sampled at the same instants, e.g. cpu user/system/idle.
+//
+// The timestamps are delta of delta encoded once, in a stream laid out like the
+// EncodedDataBlock header and timestamps. Every column is a separate XOR stream starting
+// with its raw first value, so a single column decodes without touching the others.
+class MultiValueBlock {
+
+public:
+    // Starts the block with the first row, vals holds a value per column.
+    MultiValueBlock(TSType timestamp, const std::vector<ValType>& vals);
+
+    bool WithinRange(TSType timestamp);
+    // True if any row in the block could fall between from and to, inclusive.
+    bool Overlaps(TSType from, TSType to) const;
+
+    // Throws std::invalid_argument if vals doesn't have a value per column.
+    void Append(TSType timestamp, const std::vector<ValType>& vals);
+
+    size_t NumColumns() const {
+        return columns_.size();
+    }
+
+    std::vector<Row> DecodeRows() const;
+    std::vector<TSType> DecodeTimestamps() const;
+    // Throws std::out_of_range for a column the block doesn't have.
+    std::vector<ValType> DecodeColumn(size_t column) const;
+
+    // Same as above, appending to the output of the previous blocks.
+    void DecodeRows(std::vector<Row>& rows) const;
+    void DecodeColumn(size_t column, std::vector<std::pair<TSType, ValType>>& points) const;
+
+    // Bits of the timestamps and all the columns together.
+    std::uint64_t SizeInBits() const;
+
+    // Points count rows, the value paths are summed over the columns.
+    EncoderStats Stats() const;
+
+private:
+    void CheckColumn(size_t column) const;
+    // Call emit with every timestamp or value of the column, in order.
+    template <typename Emit>
+    void ScanTimestamps(Emit emit) const;
+    template <typename Emit>
+    void ScanColumn(size_t column, Emit emit) const;
+
+    TSType start_ts_;
+
+    TSEncoderState ts_state_;
+    BitStream timestamps_;
+
+    std::vector<ValEncoderState> val_states_;
+    std::vector<BitStream> columns_;
+
+    COMPRESSION_STATS(BlockCounters counters_;)
+};
+
+// Encoder for a fixed set of columns, splits the rows into 2h blocks like Encoder.
+class MultiValueEncoder {
+
+public:
+    explicit MultiValueEncoder(size_t num_columns);
+
+    // Throws std::invalid_argument if vals doesn't have a value per column.
+    void Append(TSType timestamp, const std::vector<ValType>& vals);
+
+    size_t NumColumns() const {
+        return num_columns_;
+    }
+
+    std::vector<Row> DecodeRows() const;
+    // Points of a single column, the same as an Encoder of that series would decode.
+    // Throws std::out_of_range for a column the encoder doesn't have.
+    std::vector<std::pair<TSType, ValType>> DecodeColumn(size_t column) const;
+
+    std::uint64_t SizeInBits() const;
+    EncoderStats Stats() const;
+
+private:
+    size_t num_columns_;
+    std::vector<MultiValueBlock> blocks_;
+};
+
+} // namespace compression
+#endif
@@ -0,0 +1,122 @@
+#include <vector>
+#include <utility>
+
+#include "benchmark/benchmark.h"
+#include "compression.h"
+#include "multi_value.h"
+#include "workloads.h"
+
+// Counters sampled together (e.g. cpu user/system/idle seconds) stored as one Encoder per column
+// versus a single MultiValueEncoder. items_per_second counts values, so the variants compare
+// directly, bits_per_value includes the share of the timestamps.
+
+namespace {
+
+const int kNumRows = 1 << 16;
+
+std::vector<compression::Row> Rows(int num_columns) {
+    std::vector<compression::Row> rows;
+    for (auto& point : compression::GenerateWorkload(compression::Workload::kJittered, kNumRows, 1)) {
+        rows.push_back({point.first, {}});
+    }
+    for (int column = 0; column < num_columns; column++) {
+        auto points = compression::GenerateWorkload(compression::Workload::kMonotonicCounter, kNumRows, column + 1);
+        for (size_t i = 0; i < rows.size(); i++) {
+            rows[i].second.push_back(points[i].second);
+        }
+    }
+    return rows;
+}
+
+std::vector<compression::Encoder> EncodeSeparately(const std::vector<compression::Row>& rows, int num_columns) {
+    std::vector<compression::Encoder> encoders(num_columns);
+    for (auto& row : rows) {
+        for (int column = 0; column < num_columns; column++) {
+            encoders[column].Append(row.first, row.second[column]);
+        }
+    }
+    return encoders;
+}
+
+compression::MultiValueEncoder EncodeTogether(const std::vector<compression::Row>& rows, int num_columns) {
+    compression::MultiValueEncoder encoder(num_columns);
+    for (auto& row : rows) {
+        encoder.Append(row.first, row.second);
+    }
+    return encoder;
+}
+
+void ReportCounters(benchmark::State& state, std::uint64_t bits) {
+    std::uint64_t values = static_cast<std::uint64_t>(kNumRows) * state.range(0);
+    state.SetItemsProcessed(state.iterations() * values);
+    state.counters["bits_per_value"] = static_cast<double>(bits) / values;
+}
+
+} // namespace
+
+static void BM_EncodeSeparate(benchmark::State& state) {
+    auto rows = Rows(state.range(0));
+    std::uint64_t bits = 0;
+    for (auto _ : state) {
+        auto encoders = EncodeSeparately(rows, state.range(0));
+        bits = 0;
+        for (auto& encoder : encoders) {
+            bits += encoder.SizeInBits();
+        }
+        benchmark::ClobberMemory();
+    }
+    ReportCounters(state, bits);
+}
+BENCHMARK(BM_EncodeSeparate)->ArgName("columns")->Arg(3)->Arg(8)->Unit(benchmark::kMicrosecond);
+
+static void BM_EncodeMultiValue(benchmark::State& state) {
+    auto rows = Rows(state.range(0));
+    std::uint64_t bits = 0;
+    for (auto _ : state) {
+        auto encoder = EncodeTogether(rows, state.range(0));
+        bits = encoder.SizeInBits();
+        benchmark::ClobberMemory();
+    }
+    ReportCounters(state, bits);
+}
+BENCHMARK(BM_EncodeMultiValue)->ArgName("columns")->Arg(3)->Arg(8)->Unit(benchmark::kMicrosecond);
+
+static void BM_DecodeSeparate(benchmark::State& state) {
+    auto encoders = EncodeSeparately(Rows(state.range(0)), state.range(0));
+    std::uint64_t bits = 0;
+    for (auto& encoder : encoders) {
+        bits += encoder.SizeInBits();
+    }
+    for (auto _ : state) {
+        for (auto& encoder : encoders) {
+            auto points = encoder.Decode();
+            benchmark::DoNotOptimize(points.data());
+        }
+    }
+    ReportCounters(state, bits);
+}
+BENCHMARK(BM_DecodeSeparate)->ArgName("columns")->Arg(3)->Arg(8)->Unit(benchmark::kMicrosecond);
+
+static void BM_DecodeMultiValueColumns(benchmark::State& state) {
+    auto encoder = EncodeTogether(Rows(state.range(0)), state.range(0));
+    for (auto _ : state) {
+        for (int column = 0; column < state.range(0); column++) {
+            auto points = encoder.DecodeColumn(column);
+            benchmark::DoNotOptimize(points.data());
+        }
+    }
+    ReportCounters(state, encoder.SizeInBits());
+}
+BENCHMARK(BM_DecodeMultiValueColumns)->ArgName("columns")->Arg(3)->Arg(8)->Unit(benchmark::kMicrosecond);
+
+static void BM_DecodeMultiValueRows(benchmark::State& state) {
+    auto encoder = EncodeTogether(Rows(state.range(0)), state.range(0));
+    for (auto _ : state) {
+        auto rows = encoder.DecodeRows();
+        benchmark::DoNotOptimize(rows.data());
+    }
+    ReportCounters(state, encoder.SizeInBits());
+}
+BENCHMARK(BM_DecodeMultiValueRows)->ArgName("columns")->Arg(3)->Arg(8)->Unit(benchmark::kMicrosecond);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,89 @@
+#include <stdexcept>
+#include <utility>
+#include <vector>
+#include "compression.h"
+#include "multi_value.h"
+#include "workloads.h"
+#include "gtest/gtest.h"
+
+namespace compression {
+
+namespace {
+
+// Columns taken from differently seeded series of the workload, on the timestamps of the first one.
+std::vector<Row> SampledTogether(Workload workload, int num_points, size_t num_columns) {
+  std::vector<Row> rows;
+  for (auto& point : GenerateWorkload(workload, num_points, 1)) {
+    rows.push_back({point.first, {}});
+  }
+  for (size_t column = 0; column < num_columns; column++) {
+    auto points = GenerateWorkload(workload, num_points, column + 1);
+    for (size_t i = 0; i < rows.size(); i++) {
+      rows[i].second.push_back(points[i].second);
+    }
+  }
+  return rows;
+}
+
+} // namespace
+
+TEST(MultiValue, RowsRoundTrip) {
+  MultiValueEncoder encoder(3);
+  encoder.Append(2 * 60 * 60 + 5, {6.666, 0.5, -1});
+  encoder.Append(2 * 60 * 60 + 15, {6.666, 0.75, -1});
+  encoder.Append(2 * 60 * 60 + 313, {8.66, 0.75, 1e300});
+  encoder.Append(4 * 60 * 60 + 1, {1, 2, 3});
+
+  auto rows = encoder.DecodeRows();
+  ASSERT_EQ(4U, rows.size());
+  EXPECT_EQ(2 * 60 * 60 + 313U, rows[2].first);
+  EXPECT_EQ(std::vector<ValType>({8.66, 0.75, 1e300}), rows[2].second);
+  EXPECT_EQ(4 * 60 * 60 + 1U, rows[3].first);
+  EXPECT_EQ(std::vector<ValType>({1, 2, 3}), rows[3].second);
+}
+
+TEST(MultiValue, ColumnsMatchSeparateEncoders) {
+  for (auto workload : AllWorkloads()) {
+    auto rows = SampledTogether(workload, 3000, 3);
+    MultiValueEncoder multi(3);
+    std::vector<Encoder> separate(3);
+    for (auto& row : rows) {
+      multi.Append(row.first, row.second);
+      for (size_t column = 0; column < 3; column++) {
+        separate[column].Append(row.first, row.second[column]);
+      }
+    }
+
+    std::uint64_t separate_bits = 0;
+    for (size_t column = 0; column < 3; column++) {
+      EXPECT_EQ(separate[column].Decode(), multi.DecodeColumn(column)) << WorkloadName(workload);
+      separate_bits += separate[column].SizeInBits();
+    }
+    EXPECT_EQ(rows, multi.DecodeRows()) << WorkloadName(workload);
+    EXPECT_LT(multi.SizeInBits(), separate_bits) << WorkloadName(workload);
+  }
+}
+
+TEST(MultiValue, RejectsWrongNumberOfValues) {
+  MultiValueEncoder encoder(2);
+  EXPECT_THROW(encoder.Append(100, {1}), std::invalid_argument);
+  encoder.Append(100, {1, 2});
+  EXPECT_THROW(encoder.Append(110, {1, 2, 3}), std::invalid_argument);
+  EXPECT_THROW(encoder.DecodeColumn(2), std::out_of_range);
+  EXPECT_EQ(1U, encoder.DecodeRows().size());
+}
+
+#ifndef COMPRESSION_DISABLE_STATS
+TEST(MultiValue, StatsCountRows) {
+  MultiValueEncoder encoder(4);
+  for (int i = 0; i < 10; i++) {
+    encoder.Append(100 + 10 * i, {1, 2, 3, 4.0 + i});
+  }
+  auto stats = encoder.Stats();
+  EXPECT_EQ(10U, stats.points);
+  EXPECT_EQ(8U, stats.ts_buckets[kTSBucketZero]);
+  EXPECT_EQ(27U, stats.val_paths[kValPathZeroXor]);
+}
+#endif
+
+} // namespace compression
@@ -0,0 +1,218 @@
+#ifndef COMPRESSION_POLICY_H
+#define COMPRESSION_POLICY_H
+
+#include <cinttypes>
+#include "common.h"
+#include "compression.h"
+#include "helpers.h"
+#include "stats.h"
+
+// Block layouts as compile time policies. A policy is a struct of constexpr members, every
+// template taking one is instantiated with all its widths known, so the bucket choice in the
+// encoder and the field extraction in the decoder become straight line code with immediates.
+//
+// A policy defines:
+//   kTicksPerSecond   timestamp precision, timestamps are counted in these ticks
+//   kBlockSecs        time span of a block, blocks start at multiples of it
+//   kHeaderDeltaBits  header field for the first timestamp's offset from the block start
+//   TSDeltaBits(i)    bits of the delta of delta after the control sequence with i leading
+//                     ones: 0, 10, 110, 1110 and 1111, so i goes from 0 to 4
+//   kValueCodec       how values are stored
+//   kLeadingZeroBits  width of the leading zeros field of the XOR codec, the count is capped
+//                     to what it can hold
+
+namespace compression {
+
+enum class ValueCodec {
+    // XOR with the previous value, the meaningful bits window is reused when it still fits.
+    kXor,
+    // All 64 bits as they are. Larger, but the cheapest to decode, e.g. for noisy floats.
+    kRaw,
+};
+
+// The layout of EncodedDataBlock, from the Gorilla paper.
+struct GorillaPolicy {
+    static constexpr TSType kTicksPerSecond = 1;
+    static constexpr TSType kBlockSecs = 2 * 60 * 60;
+    static constexpr int kHeaderDeltaBits = 16;
+    static constexpr int TSDeltaBits(int leading_ones) {
+        return leading_ones == 0 ? 0 : leading_ones == 1 ? 7 : leading_ones == 2 ? 9 :
+            leading_ones == 3 ? 12 : 32;
+    }
+    static constexpr ValueCodec kValueCodec = ValueCodec::kXor;
+    static constexpr int kLeadingZeroBits = 6;
+};
+
+// Millisecond timestamps with the buckets Prometheus uses for them (the last one cut to 32 bits,
+// a block never spans more) and its 5 bit leading zeros field.
+struct MillisecondPolicy {
+    static constexpr TSType kTicksPerSecond = 1000;
+    static constexpr TSType kBlockSecs = 2 * 60 * 60;
+    static constexpr int kHeaderDeltaBits = 23;
+    static constexpr int TSDeltaBits(int leading_ones) {
+        return leading_ones == 0 ? 0 : leading_ones == 1 ? 14 : leading_ones == 2 ? 17 :
+            leading_ones == 3 ? 20 : 32;
+    }
+    static constexpr ValueCodec kValueCodec = ValueCodec::kXor;
+    static constexpr int kLeadingZeroBits = 5;
+};
+
+// Narrow buckets for scrapes a few seconds off their interval at most.
+struct RegularScrapePolicy {
+    static constexpr TSType kTicksPerSecond = 1;
+    static constexpr TSType kBlockSecs = 2 * 60 * 60;
+    static constexpr int kHeaderDeltaBits = 16;
+    static constexpr int TSDeltaBits(int leading_ones) {
+        return leading_ones == 0 ? 0 : leading_ones == 1 ? 3 : leading_ones == 2 ? 7 :
+            leading_ones == 3 ? 12 : 32;
+    }
+    static constexpr ValueCodec kValueCodec = ValueCodec::kXor;
+    static constexpr int kLeadingZeroBits = 6;
+};
+
+// Gorilla timestamps with raw values.
+struct RawValuePolicy {
+    static constexpr TSType kTicksPerSecond = 1;
+    static constexpr TSType kBlockSecs = 2 * 60 * 60;
+    static constexpr int kHeaderDeltaBits = 16;
+    static constexpr int TSDeltaBits(int leading_ones) {
+        return GorillaPolicy::TSDeltaBits(leading_ones);
+    }
+    static constexpr ValueCodec kValueCodec = ValueCodec::kRaw;
+    static constexpr int kLeadingZeroBits = 6;
+};
+
+// Properties derived from a policy.
+template <typename Policy>
+struct PolicyTraits {
+    static constexpr TSType kBlockTicks = Policy::kBlockSecs * Policy::kTicksPerSecond;
+    static constexpr int kHeaderBits = 64 + Policy::kHeaderDeltaBits + 64;
+    static constexpr int kMaxLeadingZeros = (1 << Policy::kLeadingZeroBits) - 1;
+    static constexpr int kValueHeaderBits =
+        Policy::kValueCodec == ValueCodec::kXor ? 2 + Policy::kLeadingZeroBits + 6 : 0;
+    static constexpr int kMaxTSBits = 4 + Policy::TSDeltaBits(4);
+    // Bits past the start of a point the decoder may load: the value payload is read with two
+    // 32 bit peeks after the timestamp and value header, each loading a whole word.
+    static constexpr int kDecodeReach = kMaxTSBits + kValueHeaderBits + 32 + 64;
+
+    static constexpr int TSControlLen(int leading_ones) {
+        return leading_ones < 4 ? leading_ones + 1 : 4;
+    }
+    static constexpr bool FitsTSDelta(std::int64_t delta_of_delta, int leading_ones) {
+        return delta_of_delta >= -(std::int64_t(1) << (Policy::TSDeltaBits(leading_ones) - 1)) &&
+            delta_of_delta < (std::int64_t(1) << (Policy::TSDeltaBits(leading_ones) - 1));
+    }
+
+    static_assert(Policy::TSDeltaBits(0) == 0, "the 0 control sequence stands for a repeated delta");
+    static_assert(Policy::TSDeltaBits(1) > 0 && Policy::TSDeltaBits(1) < Policy::TSDeltaBits(2) &&
+        Policy::TSDeltaBits(2) < Policy::TSDeltaBits(3) && Policy::TSDeltaBits(3) <= Policy::TSDeltaBits(4),
+        "delta of delta buckets have to grow");
+    static_assert(Policy::TSDeltaBits(4) <= 32, "delta of delta has to fit in 32 bits");
+    // The decoder reads both controls and the delta of delta from the 57 valid bits of one peek.
+    static_assert(kMaxTSBits + kValueHeaderBits <= 57, "point controls don't fit in one word");
+    static_assert(Policy::kHeaderDeltaBits <= 32 &&
+        (kBlockTicks - 1) >> Policy::kHeaderDeltaBits == 0, "header delta can't reach the block end");
+    static_assert(Policy::kLeadingZeroBits >= 1 && Policy::kLeadingZeroBits <= 6,
+        "leading zeros field is between 1 and 6 bits");
+};
+
+template <typename Policy>
+inline TSType AlignTSWith(TSType timestamp) {
+    return timestamp - timestamp % PolicyTraits<Policy>::kBlockTicks;
+}
+
+// Timestamp part of the block header: the block start and the first timestamp's offset from it.
+template <typename Policy>
+inline void EncodeTSHeaderWith(TSType timestamp, TSEncoderState& ts_state, BitStream& stream) {
+    TSType aligned_ts = AlignTSWith<Policy>(timestamp);
+    TSType delta = timestamp - aligned_ts;
+    ts_state.last_ts_delta = delta;
+    ts_state.last_ts = timestamp;
+    stream.AppendBits(64, aligned_ts);
+    stream.AppendBits(Policy::kHeaderDeltaBits, delta);
+}
+
+// Header of a block starting with the given point, see PolicyTraits::kHeaderBits.
+template <typename Policy>
+inline void EncodeHeaderWith(TSType timestamp, ValType val, TSEncoderState& ts_state,
+    ValEncoderState& val_state, BitStream& stream) {
+    EncodeTSHeaderWith<Policy>(timestamp, ts_state, stream);
+    val_state.last_val = val;
+    stream.AppendBits(64, DoubleAsInt(val));
+}
+
+// Delta of delta encoding of the timestamp.
+template <typename Policy>
+inline void EncodeTSWith(TSType timestamp, TSEncoderState& state, BitStream& stream,
+    [[maybe_unused]] BlockCounters& counters) {
+    using Traits = PolicyTraits<Policy>;
+    std::int64_t delta = static_cast<std::int64_t>(timestamp - state.last_ts);
+    std::int64_t delta_of_delta = delta - state.last_ts_delta;
+    state.last_ts_delta = delta;
+    state.last_ts = timestamp;
+    int leading_ones;
+    if (delta_of_delta == 0) {
+        stream.AppendBits(1, 0);
+        COMPRESSION_STATS(counters.ts_buckets[kTSBucketZero]++);
+        return;
+    } else if (Traits::FitsTSDelta(delta_of_delta, 1)) {
+        leading_ones = 1;
+    } else if (Traits::FitsTSDelta(delta_of_delta, 2)) {
+        leading_ones = 2;
+    } else if (Traits::FitsTSDelta(delta_of_delta, 3)) {
+        leading_ones = 3;
+    } else {
+        leading_ones = 4;
+    }
+    // Control sequence with the bits of the delta of delta appended, at most 36 bits.
+    int control_len = Traits::TSControlLen(leading_ones);
+    int delta_bits = Policy::TSDeltaBits(leading_ones);
+    std::uint64_t control = leading_ones < 4 ? (std::uint64_t(1) << control_len) - 2 : 0xF;
+    std::uint64_t mask = (std::uint64_t(1) << delta_bits) - 1;
+    stream.AppendBits(control_len + delta_bits,
+        control << delta_bits | (static_cast<std::uint64_t>(delta_of_delta) & mask));
+    COMPRESSION_STATS(counters.ts_buckets[leading_ones]++);
+}
+
+// Encoding of the value against the previous one.
+template <typename Policy>
+inline void EncodeValWith(ValType val, ValEncoderState& state, BitStream& stream,
+    [[maybe_unused]] BlockCounters& counters) {
+    if (Policy::kValueCodec == ValueCodec::kRaw) {
+        stream.AppendBits(64, DoubleAsInt(val));
+        state.last_val = val;
+        return;
+    }
+    std::uint64_t xored = DoubleAsInt(val) ^ DoubleAsInt(state.last_val);
+    if (xored == 0) {
+        stream.AppendBits(1, 0);
+        COMPRESSION_STATS(counters.val_paths[kValPathZeroXor]++);
+        return;
+    }
+
+    int leading_zero_bits = LeadingZeroBits(xored);
+    if (leading_zero_bits > PolicyTraits<Policy>::kMaxLeadingZeros) {
+        leading_zero_bits = PolicyTraits<Policy>::kMaxLeadingZeros;
+    }
+    int trailing_zero_bits = TrailingZeroBits(xored);
+    int meaningful_bits = 64 - leading_zero_bits - trailing_zero_bits;
+
+    if (state.last_xor_leading_zeros != -1 && leading_zero_bits == state.last_xor_leading_zeros &&
+        state.last_xor_meaningful_bits == meaningful_bits) {
+        stream.AppendBits(2, 0b10);
+        stream.AppendBits(meaningful_bits, TrimToMeaningfulBits(xored, leading_zero_bits, trailing_zero_bits));
+        COMPRESSION_STATS(counters.val_paths[kValPathReuseWindow]++);
+    } else {
+        // 64 meaningful bits don't fit in 6 bits, they are stored as 0 which can't happen otherwise.
+        stream.AppendBits(2 + Policy::kLeadingZeroBits + 6,
+            std::uint64_t(0b11) << (Policy::kLeadingZeroBits + 6) | leading_zero_bits << 6 | (meaningful_bits & 0x3F));
+        stream.AppendBits(meaningful_bits, TrimToMeaningfulBits(xored, leading_zero_bits, trailing_zero_bits));
+        COMPRESSION_STATS(counters.val_paths[kValPathNewWindow]++);
+    }
+    state.last_val = val;
+    state.last_xor_leading_zeros = leading_zero_bits;
+    state.last_xor_meaningful_bits = meaningful_bits;
+}
+
+} // namespace compression
+#endif
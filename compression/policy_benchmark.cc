@@ -0,0 +1,83 @@
+#include <utility>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "compression.h"
+#include "policy.h"
+#include "policy_block.h"
+#include "workloads.h"
+
+// The block layouts of policy.h on the same workloads. bits_per_point compares the ratio,
+// items_per_second counts points. MillisecondPolicy gets the timestamps in milliseconds with a
+// few ms of jitter, as a millisecond scraper would produce them.
+
+namespace {
+
+const int kNumPoints = 1 << 16;
+
+compression::Workload WorkloadArg(benchmark::State& state) {
+    return compression::AllWorkloads()[state.range(0)];
+}
+
+template <typename Policy>
+std::vector<std::pair<compression::TSType, compression::ValType>> Points(compression::Workload workload) {
+    auto points = compression::GenerateWorkload(workload, kNumPoints);
+    if (Policy::kTicksPerSecond != 1) {
+        for (size_t i = 0; i < points.size(); i++) {
+            points[i].first = points[i].first * Policy::kTicksPerSecond + (i * 7919) % 13;
+        }
+    }
+    return points;
+}
+
+template <typename Policy>
+compression::PolicyEncoder<Policy> Encode(const std::vector<std::pair<compression::TSType, compression::ValType>>& points) {
+    compression::PolicyEncoder<Policy> encoder;
+    for (auto& point : points) {
+        encoder.Append(point.first, point.second);
+    }
+    return encoder;
+}
+
+template <typename Policy>
+void BM_PolicyEncode(benchmark::State& state) {
+    auto points = Points<Policy>(WorkloadArg(state));
+    std::uint64_t bits = 0;
+    for (auto _ : state) {
+        auto encoder = Encode<Policy>(points);
+        bits = encoder.SizeInBits();
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * points.size());
+    state.counters["bits_per_point"] = static_cast<double>(bits) / points.size();
+    state.SetLabel(compression::WorkloadName(WorkloadArg(state)));
+}
+
+template <typename Policy>
+void BM_PolicyDecode(benchmark::State& state) {
+    auto points = Points<Policy>(WorkloadArg(state));
+    auto encoder = Encode<Policy>(points);
+    std::vector<std::pair<compression::TSType, compression::ValType>> output;
+    for (auto _ : state) {
+        output.clear();
+        for (size_t i = 0; i < encoder.NumBlocks(); i++) {
+            encoder.Block(i).Decode(output);
+        }
+        benchmark::DoNotOptimize(output.data());
+    }
+    state.SetItemsProcessed(state.iterations() * points.size());
+    state.counters["bits_per_point"] = static_cast<double>(encoder.SizeInBits()) / points.size();
+    state.SetLabel(compression::WorkloadName(WorkloadArg(state)));
+}
+
+} // namespace
+
+BENCHMARK_TEMPLATE(BM_PolicyEncode, compression::GorillaPolicy)->DenseRange(0, 7);
+BENCHMARK_TEMPLATE(BM_PolicyEncode, compression::RegularScrapePolicy)->DenseRange(0, 7);
+BENCHMARK_TEMPLATE(BM_PolicyEncode, compression::RawValuePolicy)->DenseRange(0, 7);
+BENCHMARK_TEMPLATE(BM_PolicyEncode, compression::MillisecondPolicy)->DenseRange(0, 7);
+
+BENCHMARK_TEMPLATE(BM_PolicyDecode, compression::GorillaPolicy)->DenseRange(0, 7);
+BENCHMARK_TEMPLATE(BM_PolicyDecode, compression::RegularScrapePolicy)->DenseRange(0, 7);
+BENCHMARK_TEMPLATE(BM_PolicyDecode, compression::RawValuePolicy)->DenseRange(0, 7);
+BENCHMARK_TEMPLATE(BM_PolicyDecode, compression::MillisecondPolicy)->DenseRange(0, 7);
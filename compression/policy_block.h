@@ -0,0 +1,100 @@
+#ifndef COMPRESSION_POLICY_BLOCK_H
+#define COMPRESSION_POLICY_BLOCK_H
+
+#include <utility>
+#include <vector>
+#include <cinttypes>
+#include "bit_reader.h"
+#include "common.h"
+#include "compression.h"
+#include "policy.h"
+
+namespace compression {
+
+// Block with the layout of Policy, see policy.h. PolicyBlock<GorillaPolicy> writes the same
+// stream as EncodedDataBlock, which stays the block type the rest of the library works with.
+template <typename Policy>
+class PolicyBlock {
+
+public:
+    PolicyBlock(TSType timestamp, ValType val): start_ts_(AlignTSWith<Policy>(timestamp)) {
+        EncodeHeaderWith<Policy>(timestamp, val, ts_state_, val_state_, stream_);
+    }
+
+    bool WithinRange(TSType timestamp) const {
+        return timestamp - start_ts_ < PolicyTraits<Policy>::kBlockTicks;
+    }
+
+    void Append(TSType timestamp, ValType val) {
+        EncodeTSWith<Policy>(timestamp, ts_state_, stream_, COMPRESSION_COUNTERS(counters_));
+        EncodeValWith<Policy>(val, val_state_, stream_, COMPRESSION_COUNTERS(counters_));
+    }
+
+    std::vector<std::pair<TSType, ValType>> Decode() const {
+        std::vector<std::pair<TSType, ValType>> output;
+        Decode(output);
+        return output;
+    }
+
+    // Appending version, to reuse the output between calls.
+    void Decode(std::vector<std::pair<TSType, ValType>>& output) const {
+        DecodeStreamWith<Policy>(stream_, output);
+    }
+
+    const std::vector<std::uint8_t>& Bytes() const {
+        return stream_.data;
+    }
+    std::uint64_t SizeInBits() const {
+        return stream_.SizeInBits();
+    }
+
+private:
+    TSType start_ts_;
+    TSEncoderState ts_state_;
+    ValEncoderState val_state_;
+    BitStream stream_;
+    COMPRESSION_STATS(BlockCounters counters_;)
+};
+
+// Series of PolicyBlocks, cut like Encoder cuts its blocks.
+template <typename Policy>
+class PolicyEncoder {
+
+public:
+    void Append(TSType timestamp, ValType val) {
+        if (!blocks_.empty() && blocks_.back().WithinRange(timestamp)) {
+            blocks_.back().Append(timestamp, val);
+        } else {
+            blocks_.emplace_back(timestamp, val);
+        }
+    }
+
+    std::vector<std::pair<TSType, ValType>> Decode() const {
+        std::vector<std::pair<TSType, ValType>> output;
+        for (auto& block : blocks_) {
+            block.Decode(output);
+        }
+        return output;
+    }
+
+    size_t NumBlocks() const {
+        return blocks_.size();
+    }
+    const PolicyBlock<Policy>& Block(size_t block) const {
+        return blocks_.at(block);
+    }
+
+    std::uint64_t SizeInBits() const {
+        std::uint64_t bits = 0;
+        for (auto& block : blocks_) {
+            bits += block.SizeInBits();
+        }
+        return bits;
+    }
+
+private:
+    std::vector<PolicyBlock<Policy>> blocks_;
+};
+
+} // namespace compression
+#endif
@@ -0,0 +1,142 @@
+#include <string>
+#include <utility>
+#include <vector>
+#include "bit_reader.h"
+#include "compression.h"
+#include "policy.h"
+#include "policy_block.h"
+#include "workloads.h"
+#include "gtest/gtest.h"
+
+namespace compression {
+
+namespace {
+
+template <typename Policy>
+void ExpectRoundTrip(const std::vector<std::pair<TSType, ValType>>& points, const std::string& name) {
+  PolicyEncoder<Policy> encoder;
+  for (auto& point : points) {
+    encoder.Append(point.first, point.second);
+  }
+  auto decoded = encoder.Decode();
+  ASSERT_EQ(points.size(), decoded.size()) << name;
+  for (size_t i = 0; i < points.size(); i++) {
+    ASSERT_EQ(points[i].first, decoded[i].first) << name << " point " << i;
+    ASSERT_EQ(DoubleAsInt(points[i].second), DoubleAsInt(decoded[i].second)) << name << " point " << i;
+  }
+}
+
+// Decodes a block like Deserialize validates it, through the checked variants.
+template <typename Policy>
+std::vector<std::pair<TSType, ValType>> DecodeChecked(const std::vector<std::uint8_t>& bytes,
+    std::uint64_t size_bits) {
+  const std::uint8_t* data = bytes.data();
+  std::uint64_t size = bytes.size();
+  auto peek = [data, size](std::uint64_t pos) { return PeekBitsTail(data, size, pos); };
+  StreamState state;
+  BlockCounters counters;
+  TSType start_ts = ReadBlockHeaderCheckedWith<Policy>(peek, size_bits, state);
+  std::vector<std::pair<TSType, ValType>> output = {{state.ts, DoubleFromInt(state.val)}};
+  std::uint64_t pos = PolicyTraits<Policy>::kHeaderBits;
+  while (pos < size_bits) {
+    pos = DecodePointCheckedWith<Policy>(peek, pos, size_bits, start_ts, state, counters);
+    output.push_back({state.ts, DoubleFromInt(state.val)});
+  }
+  return output;
+}
+
+// Every block passes the checked decoder and fails it once it's cut short.
+template <typename Policy>
+void ExpectCheckedDecodes(const std::vector<std::pair<TSType, ValType>>& points, const std::string& name) {
+  PolicyEncoder<Policy> encoder;
+  for (auto& point : points) {
+    encoder.Append(point.first, point.second);
+  }
+  for (size_t i = 0; i < encoder.NumBlocks(); i++) {
+    auto& block = encoder.Block(i);
+    EXPECT_EQ(block.Decode(), DecodeChecked<Policy>(block.Bytes(), block.SizeInBits())) << name << " block " << i;
+    if (block.SizeInBits() > PolicyTraits<Policy>::kHeaderBits) {
+      EXPECT_THROW(DecodeChecked<Policy>(block.Bytes(), block.SizeInBits() - 1), ParsingError)
+          << name << " block " << i;
+    }
+    EXPECT_THROW(DecodeChecked<Policy>(block.Bytes(), PolicyTraits<Policy>::kHeaderBits - 1), ParsingError)
+        << name << " block " << i;
+  }
+}
+
+// Seconds to milliseconds, with a few ms of scrape jitter.
+std::vector<std::pair<TSType, ValType>> Milliseconds(const std::vector<std::pair<TSType, ValType>>& points) {
+  std::vector<std::pair<TSType, ValType>> output;
+  for (size_t i = 0; i < points.size(); i++) {
+    output.push_back({points[i].first * 1000 + (i * 7919) % 13, points[i].second});
+  }
+  return output;
+}
+
+} // namespace
+
+TEST(Policy, GorillaPolicyIsTheBlockLayout) {
+  for (auto workload : AllWorkloads()) {
+    auto points = GenerateWorkload(workload, 3000);
+    Encoder encoder;
+    PolicyEncoder<GorillaPolicy> policy_encoder;
+    for (auto& point : points) {
+      encoder.Append(point.first, point.second);
+      policy_encoder.Append(point.first, point.second);
+    }
+    ASSERT_EQ(encoder.NumBlocks(), policy_encoder.NumBlocks()) << WorkloadName(workload);
+    EXPECT_EQ(encoder.SizeInBits(), policy_encoder.SizeInBits()) << WorkloadName(workload);
+    EXPECT_EQ(encoder.Decode(), policy_encoder.Decode()) << WorkloadName(workload);
+  }
+}
+
+TEST(Policy, EveryPolicyRoundTrips) {
+  for (auto workload : AllWorkloads()) {
+    auto points = GenerateWorkload(workload, 5000);
+    ExpectRoundTrip<GorillaPolicy>(points, WorkloadName(workload));
+    ExpectRoundTrip<RegularScrapePolicy>(points, WorkloadName(workload));
+    ExpectRoundTrip<RawValuePolicy>(points, WorkloadName(workload));
+    ExpectRoundTrip<MillisecondPolicy>(Milliseconds(points), WorkloadName(workload));
+  }
+}
+
+TEST(Policy, EdgesOfTheLayout) {
+  // Timestamps right before the end of a block, large jumps and values differing in the last
+  // bit, which need more leading zeros than a 5 bit field holds.
+  const TSType kBlockMs = 2 * 60 * 60 * 1000;
+  std::vector<std::pair<TSType, ValType>> points = {
+      {kBlockMs - 1, 1.0}, {kBlockMs, 1.0}, {kBlockMs + 1, 1.0000000000000002},
+      {kBlockMs + 2, 1.0}, {kBlockMs + 3, -1.0}, {2 * kBlockMs - 1, 1e300},
+      {2 * kBlockMs + 5000, 0.0}, {2 * kBlockMs + 5001, 0.0}};
+  ExpectRoundTrip<MillisecondPolicy>(points, "milliseconds");
+  ExpectRoundTrip<GorillaPolicy>(points, "gorilla");
+  ExpectRoundTrip<RegularScrapePolicy>(points, "regular scrape");
+}
+
+TEST(Policy, CheckedDecoderValidatesEveryLayout) {
+  for (auto workload : AllWorkloads()) {
+    auto points = GenerateWorkload(workload, 3000);
+    ExpectCheckedDecodes<GorillaPolicy>(points, WorkloadName(workload));
+    ExpectCheckedDecodes<RawValuePolicy>(points, WorkloadName(workload));
+    ExpectCheckedDecodes<MillisecondPolicy>(Milliseconds(points), WorkloadName(workload));
+  }
+  // Leading zeros past what the 5 bit field holds.
+  std::vector<std::pair<TSType, ValType>> capped = {
+      {7200000, 1.0}, {7200010, 1.0000000000000002}, {7200020, 1.0}, {7200035, 1.0000000000000004}};
+  ExpectCheckedDecodes<MillisecondPolicy>(capped, "capped leading zeros");
+}
+
+TEST(Policy, RatioFollowsTheBuckets) {
+  auto points = GenerateWorkload(Workload::kRegular, 20000);
+  PolicyEncoder<GorillaPolicy> gorilla;
+  PolicyEncoder<RawValuePolicy> raw;
+  for (auto& point : points) {
+    gorilla.Append(point.first, point.second);
+    raw.Append(point.first, point.second);
+  }
+  // Raw values cost 64 bits each.
+  EXPECT_GT(raw.SizeInBits(), gorilla.SizeInBits());
+  EXPECT_GE(raw.SizeInBits(), 64 * points.size());
+}
+
+} // namespace compression
@@ -0,0 +1,138 @@
+#include <algorithm>
+#include <utility>
+#include <vector>
+#include "compression.h"
+#include "store.h"
+#include "gtest/gtest.h"
+
+namespace compression {
+
+namespace {
+
+const TSType kStart = 1514764800;
+const TSType kHour = 60 * 60;
+
+void AppendHours(Encoder& encoder, TSType from, int hours) {
+  for (TSType ts = from; ts < from + hours * kHour; ts += 10) {
+    encoder.Append(ts, ts % 7);
+  }
+}
+
+void AppendHours(SeriesStore& store, const std::string& series, TSType from, int hours) {
+  for (TSType ts = from; ts < from + hours * kHour; ts += 10) {
+    store.Append(series, ts, ts % 7);
+  }
+}
+
+} // namespace
+
+TEST(Retention, MaxAgeDropsExpiredBlocks) {
+  RetentionPolicy retention;
+  retention.max_age_secs = 6 * kHour;
+  Encoder encoder(retention);
+  AppendHours(encoder, kStart, 30);
+
+  // Three 2h blocks cover the 6h, the oldest one may still hold a newer point than the cutoff.
+  EXPECT_EQ(4U, encoder.NumBlocks());
+  auto points = encoder.Decode();
+  TSType last = kStart + 30 * kHour - 10;
+  EXPECT_EQ(last, points.back().first);
+  EXPECT_GE(points.front().first, last - 8 * kHour);
+  EXPECT_LE(points.front().first, last - 6 * kHour);
+  EXPECT_EQ(11U, encoder.Stats().evicted_blocks);
+
+  // Iterating over the remaining blocks starts at the oldest kept one.
+  EXPECT_EQ(points.front(), *encoder.begin());
+}
+
+TEST(Retention, MaxAgeLongerThanTheTimestamps) {
+  // The cutoff would be before the epoch, nothing has expired yet.
+  RetentionPolicy retention;
+  retention.max_age_secs = 100000;
+  Encoder encoder(retention);
+  AppendHours(encoder, 0, 6);
+  EXPECT_EQ(3U, encoder.NumBlocks());
+  EXPECT_EQ(0U, encoder.Stats().evicted_blocks);
+}
+
+TEST(Retention, MaxBytesKeepsTheHeadBlock) {
+  Encoder unlimited;
+  AppendHours(unlimited, kStart, 10);
+  std::uint64_t block_bytes = unlimited.SizeInBytes() / unlimited.NumBlocks();
+
+  RetentionPolicy retention;
+  retention.max_bytes = 2 * block_bytes;
+  Encoder encoder(retention);
+  AppendHours(encoder, kStart, 10);
+  EXPECT_LE(encoder.SizeInBytes(), retention.max_bytes);
+  EXPECT_LT(encoder.NumBlocks(), unlimited.NumBlocks());
+  // What's left are the newest points.
+  auto all = unlimited.Decode();
+  auto kept = encoder.Decode();
+  ASSERT_LT(kept.size(), all.size());
+  EXPECT_TRUE(std::equal(kept.begin(), kept.end(), all.end() - kept.size()));
+
+  // A limit below the head block can't be met, the head block stays.
+  encoder.EvictToSize(0);
+  EXPECT_EQ(1U, encoder.NumBlocks());
+  EXPECT_FALSE(encoder.EvictOldest());
+  EXPECT_EQ(kStart + 10 * kHour - 10, encoder.Decode().back().first);
+}
+
+TEST(Retention, SizeInBytesMatchesBlocks) {
+  Encoder encoder;
+  EXPECT_EQ(0U, encoder.SizeInBytes());
+  AppendHours(encoder, kStart + 5, 9);
+  EXPECT_EQ(5U, encoder.NumBlocks());
+  EXPECT_EQ(encoder.Stats().bytes, encoder.SizeInBytes());
+
+  TSType last;
+  ASSERT_TRUE(encoder.LastTS(last));
+  EXPECT_EQ(kStart + 5 + 9 * kHour - 10, last);
+  EXPECT_EQ(4U, encoder.EvictBefore(last));
+  EXPECT_EQ(encoder.Stats().bytes, encoder.SizeInBytes());
+}
+
+TEST(SeriesStore, DropsExpiredSeries) {
+  RetentionPolicy retention;
+  retention.max_age_secs = 4 * kHour;
+  SeriesStore store(retention);
+  AppendHours(store, "cpu", kStart, 12);
+  AppendHours(store, "gone", kStart, 2);
+  ASSERT_EQ(2U, store.NumSeries());
+
+  // Appending already kept "cpu" to the blocks ending within 4h of its newest point.
+  ASSERT_NE(nullptr, store.Find("cpu"));
+  EXPECT_EQ(3U, store.Find("cpu")->NumBlocks());
+
+  // "gone" had no point for 10h, its block is dropped with the series.
+  EXPECT_EQ(2U, store.EnforceRetention(kStart + 12 * kHour));
+  EXPECT_EQ(1U, store.NumSeries());
+  EXPECT_EQ(nullptr, store.Find("gone"));
+  EXPECT_EQ(2U, store.Find("cpu")->NumBlocks());
+
+  // Later on "cpu" ages out as well.
+  EXPECT_EQ(1U, store.EnforceRetention(kStart + 14 * kHour));
+  EXPECT_EQ(1U, store.Find("cpu")->NumBlocks());
+  EXPECT_EQ(1U, store.EnforceRetention(kStart + 17 * kHour));
+  EXPECT_EQ(0U, store.NumSeries());
+  EXPECT_EQ(7U, store.Stats().evicted_blocks);
+}
+
+TEST(SeriesStore, BudgetEvictsOldestBlocksFirst) {
+  SeriesStore unlimited;
+  AppendHours(unlimited, "a", kStart, 8);
+  // Room for the four blocks of "a" and some, blocks differ by a few bytes.
+  std::uint64_t series_bytes = unlimited.SizeInBytes() + unlimited.SizeInBytes() / 8;
+
+  SeriesStore store(RetentionPolicy(), series_bytes);
+  AppendHours(store, "a", kStart, 8);
+  AppendHours(store, "b", kStart + 4 * kHour, 4);
+  store.EnforceRetention(kStart + 8 * kHour);
+  EXPECT_LE(store.SizeInBytes(), series_bytes);
+  // Both series end at the same time, so "a" loses its blocks from before "b" started.
+  EXPECT_EQ(kStart + 4 * kHour, store.Find("a")->Decode().front().first);
+  EXPECT_EQ(kStart + 4 * kHour, store.Find("b")->Decode().front().first);
+}
+
+} // namespace compression
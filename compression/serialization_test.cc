@@ -0,0 +1,120 @@
+#include <random>
+#include <utility>
+#include <vector>
+#include "compression.h"
+#include "workloads.h"
+#include "gtest/gtest.h"
+
+namespace compression {
+
+EncodedDataBlock* EncodeBlock(const std::vector<std::pair<TSType, ValType>>& points, size_t* encoded = nullptr) {
+  auto block = new EncodedDataBlock(points[0].first, points[0].second);
+  size_t i = 1;
+  for (; i < points.size() && block->WithinRange(points[i].first); i++) {
+    block->Append(points[i].first, points[i].second);
+  }
+  if (encoded) {
+    *encoded = i;
+  }
+  return block;
+}
+
+TEST(Serialization, RoundTripAllWorkloads) {
+  for (auto workload : AllWorkloads()) {
+    auto points = GenerateWorkload(workload, 1000);
+    std::unique_ptr<EncodedDataBlock> block(EncodeBlock(points));
+    auto frame = block->Serialize();
+    std::unique_ptr<EncodedDataBlock> parsed(EncodedDataBlock::Deserialize(frame.data(), frame.size()));
+    EXPECT_EQ(block->Decode(), parsed->Decode()) << WorkloadName(workload);
+    EXPECT_EQ(block->Bytes(), parsed->Bytes()) << WorkloadName(workload);
+    EXPECT_EQ(frame, parsed->Serialize()) << WorkloadName(workload);
+  }
+}
+
+TEST(Serialization, DeserializedBlockCanBeAppendedTo) {
+  auto points = GenerateWorkload(Workload::kRandomWalkGauge, 200);
+  std::unique_ptr<EncodedDataBlock> block(EncodeBlock(points));
+  auto frame = block->Serialize();
+  std::unique_ptr<EncodedDataBlock> parsed(EncodedDataBlock::Deserialize(frame.data(), frame.size()));
+
+  TSType ts = points.back().first;
+  for (int i = 1; i < 50; i++) {
+    block->Append(ts + i * 15, i * 0.5);
+    parsed->Append(ts + i * 15, i * 0.5);
+  }
+  EXPECT_EQ(block->Bytes(), parsed->Bytes());
+  EXPECT_EQ(block->Stats().val_paths[kValPathNewWindow], parsed->Stats().val_paths[kValPathNewWindow]);
+}
+
+TEST(Serialization, DetectsCorruptedFrames) {
+  auto points = GenerateWorkload(Workload::kJittered, 300);
+  std::unique_ptr<EncodedDataBlock> block(EncodeBlock(points));
+  auto frame = block->Serialize();
+  for (size_t i = 0; i < frame.size(); i++) {
+    for (int bit = 0; bit < 8; bit++) {
+      auto corrupted = frame;
+      corrupted[i] ^= 1 << bit;
+      EXPECT_THROW(EncodedDataBlock::Deserialize(corrupted.data(), corrupted.size()), ParsingError);
+    }
+  }
+  for (size_t size = 0; size < frame.size(); size++) {
+    EXPECT_THROW(EncodedDataBlock::Deserialize(frame.data(), size), ParsingError);
+  }
+}
+
+// Streams with a valid checksum but garbage inside must be rejected by validation, not crash.
+TEST(Serialization, ValidatesStreamsWithCorrectChecksum) {
+  auto points = GenerateWorkload(Workload::kNoisyFloat, 200);
+  std::unique_ptr<EncodedDataBlock> block(EncodeBlock(points));
+  std::mt19937 rng(7);
+  int accepted = 0;
+  for (int round = 0; round < 2000; round++) {
+    auto data = block->Bytes();
+    // Corrupt anything past the 18 byte block header.
+    std::uniform_int_distribution<size_t> position(18, data.size() - 1);
+    data[position(rng)] ^= 1 << (rng() % 8);
+    data.resize(data.size() - rng() % 3);
+
+    std::vector<std::uint8_t> frame(8);
+    std::uint32_t size_bits = data.size() * 8 - rng() % 8;
+    for (int i = 0; i < 4; i++) {
+      frame[i] = (size_bits >> (8 * i)) & 0xFF;
+    }
+    std::uint32_t crc = Crc32(data.data(), data.size(), Crc32(frame.data(), 4));
+    for (int i = 0; i < 4; i++) {
+      frame[4 + i] = (crc >> (8 * i)) & 0xFF;
+    }
+    frame.insert(frame.end(), data.begin(), data.end());
+
+    std::unique_ptr<EncodedDataBlock> parsed;
+    try {
+      parsed.reset(EncodedDataBlock::Deserialize(frame.data(), frame.size()));
+    } catch (const ParsingError&) {
+      continue;
+    }
+    accepted++;
+    std::vector<std::pair<TSType, ValType>> checked(parsed->begin(), parsed->end());
+    auto fast = parsed->Decode();
+    ASSERT_EQ(checked.size(), fast.size());
+    for (size_t i = 0; i < fast.size(); i++) {
+      ASSERT_EQ(checked[i].first, fast[i].first);
+      ASSERT_EQ(DoubleAsInt(checked[i].second), DoubleAsInt(fast[i].second));
+    }
+  }
+  EXPECT_LT(accepted, 2000);
+}
+
+TEST(Decoding, IteratorRejectsReuseWithoutWindow) {
+  auto block = EncodedDataBlock(2 * 60 * 60, 1.0);
+  // 144 bits of header, 9 bits of delta of delta 10 and a 0 for the repeated value.
+  block.Append(2 * 60 * 60 + 10, 1.0);
+  ASSERT_EQ(154U, block.SizeInBits());
+  // Turn the repeated value at bit 153 into 0b10, a reuse of a window that was never set.
+  auto corrupted = block.Bytes();
+  corrupted[19] |= 0b01000000;
+  DataIterator it(&corrupted);
+  ++it;
+  EXPECT_THROW(*it, ParsingError);
+}
+
+} // namespace compression
@@ -0,0 +1,116 @@
+#include <atomic>
+#include <sstream>
+#include "stats.h"
+
+namespace compression {
+
+namespace {
+
+std::atomic<std::uint64_t> decode_errors(0);
+
+const char* kTSBucketNames[kNumTSBuckets] = {"0", "7", "9", "12", "32"};
+const char* kValPathNames[kNumValPaths] = {"zero_xor", "reuse_window", "new_window"};
+
+int BlockSizeBucket(std::uint64_t block_bytes) {
+    int bucket = 0;
+    while (bucket < kNumBlockSizeBuckets - 1 && block_bytes > (64u << bucket)) {
+        bucket++;
+    }
+    return bucket;
+}
+
+} // namespace
+
+EncoderStats& EncoderStats::operator+=(const EncoderStats& other) {
+    encoders += other.encoders;
+    blocks += other.blocks;
+    points += other.points;
+    bytes += other.bytes;
+    evicted_blocks += other.evicted_blocks;
+    for (int i = 0; i < kNumTSBuckets; i++) {
+        ts_buckets[i] += other.ts_buckets[i];
+    }
+    for (int i = 0; i < kNumValPaths; i++) {
+        val_paths[i] += other.val_paths[i];
+    }
+    for (int i = 0; i < kNumBlockSizeBuckets; i++) {
+        block_size_buckets[i] += other.block_size_buckets[i];
+    }
+    return *this;
+}
+
+void EncoderStats::AddBlock(std::uint64_t block_bytes, [[maybe_unused]] const BlockCounters& counters) {
+    blocks++;
+    bytes += block_bytes;
+    block_size_buckets[BlockSizeBucket(block_bytes)]++;
+#ifndef COMPRESSION_DISABLE_STATS
+    // The first point lives in the block header and isn't counted by any bucket.
+    points++;
+    for (int i = 0; i < kNumTSBuckets; i++) {
+        ts_buckets[i] += counters.ts_buckets[i];
+        points += counters.ts_buckets[i];
+    }
+    for (int i = 0; i < kNumValPaths; i++) {
+        val_paths[i] += counters.val_paths[i];
+    }
+#endif
+}
+
+std::string EncoderStats::ToText(const std::string& prefix) const {
+    std::ostringstream out;
+    out << "# TYPE " << prefix << "_encoders gauge\n";
+    out << prefix << "_encoders " << encoders << "\n";
+    out << "# TYPE " << prefix << "_blocks gauge\n";
+    out << prefix << "_blocks " << blocks << "\n";
+#ifndef COMPRESSION_DISABLE_STATS
+    out << "# TYPE " << prefix << "_points gauge\n";
+    out << prefix << "_points " << points << "\n";
+#endif
+
+    // Counted over the retained blocks, eviction lowers them.
+    out << "# TYPE " << prefix << "_ts_bucket gauge\n";
+    for (int i = 0; i < kNumTSBuckets; i++) {
+        out << prefix << "_ts_bucket{bits=\"" << kTSBucketNames[i] << "\"} " << ts_buckets[i] << "\n";
+    }
+    out << "# TYPE " << prefix << "_val_path gauge\n";
+    for (int i = 0; i < kNumValPaths; i++) {
+        out << prefix << "_val_path{path=\"" << kValPathNames[i] << "\"} " << val_paths[i] << "\n";
+    }
+
+    out << "# TYPE " << prefix << "_block_bytes histogram\n";
+    std::uint64_t cumulative = 0;
+    for (int i = 0; i < kNumBlockSizeBuckets; i++) {
+        cumulative += block_size_buckets[i];
+        out << prefix << "_block_bytes_bucket{le=\"";
+        if (i == kNumBlockSizeBuckets - 1) {
+            out << "+Inf";
+        } else {
+            out << (64u << i);
+        }
+        out << "\"} " << cumulative << "\n";
+    }
+    out << prefix << "_block_bytes_sum " << bytes << "\n";
+    out << prefix << "_block_bytes_count " << blocks << "\n";
+
+    out << "# TYPE " << prefix << "_evicted_blocks_total counter\n";
+    out << prefix << "_evicted_blocks_total " << evicted_blocks << "\n";
+
+    out << "# TYPE " << prefix << "_decode_errors_total counter\n";
+    out << prefix << "_decode_errors_total " << DecodeErrors() << "\n";
+    return out.str();
+}
+
+std::uint64_t DecodeErrors() {
+    return decode_errors.load(std::memory_order_relaxed);
+}
+
+void RecordDecodeError() {
+    decode_errors.fetch_add(1, std::memory_order_relaxed);
+}
+
+void ThrowParsingError(const std::string& msg) {
+    COMPRESSION_STATS(RecordDecodeError());
+    throw ParsingError(msg);
+}
+
+} // namespace compression
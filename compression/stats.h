@@ -0,0 +1,86 @@
+#ifndef COMPRESSION_STATS_H
+#define COMPRESSION_STATS_H
+
+#include <string>
+#include <cinttypes>
+#include "common.h"
+
+// Counters are updated on the encoding hot path, build with -DCOMPRESSION_DISABLE_STATS
+// (e.g. bazel build --copt=-DCOMPRESSION_DISABLE_STATS) to compile them out. Blocks declare
+// their counters with COMPRESSION_STATS and pass them on with COMPRESSION_COUNTERS, which
+// stands in an empty BlockCounters when they don't exist.
+#ifdef COMPRESSION_DISABLE_STATS
+#define COMPRESSION_STATS(statement)
+#define COMPRESSION_COUNTERS(counters) (::compression::NoCounters())
+#else
+#define COMPRESSION_STATS(statement) statement
+#define COMPRESSION_COUNTERS(counters) (counters)
+#endif
+
+namespace compression {
+
+// Delta of delta bucket picked by EncodeTS.
+enum TSBucket {
+    kTSBucketZero,
+    kTSBucket7Bits,
+    kTSBucket9Bits,
+    kTSBucket12Bits,
+    kTSBucket32Bits,
+    kNumTSBuckets,
+};
+
+// Path taken by EncodeVal.
+enum ValPath {
+    kValPathZeroXor,
+    kValPathReuseWindow,
+    kValPathNewWindow,
+    kNumValPaths,
+};
+
+// Histogram of block sizes, bucket i counts blocks of at most 64 << i bytes, the last one the rest.
+const int kNumBlockSizeBuckets = 12;
+
+#ifdef COMPRESSION_DISABLE_STATS
+struct BlockCounters {};
+
+// Never written, there is nothing to write.
+inline BlockCounters& NoCounters() {
+    static BlockCounters counters;
+    return counters;
+}
+#else
+// Per block counters, kept small since every block carries them.
+struct BlockCounters {
+    std::uint32_t ts_buckets[kNumTSBuckets] = {};
+    std::uint32_t val_paths[kNumValPaths] = {};
+};
+#endif
+
+// Aggregated view over blocks, encoders or a whole store, combine them with +=.
+struct EncoderStats {
+    std::uint64_t encoders = 0;
+    std::uint64_t blocks = 0;
+    // Derived from the bucket counters, 0 and not exported when they are compiled out.
+    std::uint64_t points = 0;
+    std::uint64_t bytes = 0;
+    // Blocks dropped by retention, see RetentionPolicy.
+    std::uint64_t evicted_blocks = 0;
+    std::uint64_t ts_buckets[kNumTSBuckets] = {};
+    std::uint64_t val_paths[kNumValPaths] = {};
+    std::uint64_t block_size_buckets[kNumBlockSizeBuckets] = {};
+
+    EncoderStats& operator+=(const EncoderStats& other);
+
+    // Adds a single block of the given size with its counters.
+    void AddBlock(std::uint64_t block_bytes, const BlockCounters& counters);
+
+    // Prometheus text exposition format, metric names start with prefix.
+    std::string ToText(const std::string& prefix = "compression") const;
+};
+
+// Number of ParsingErrors thrown while decoding, process wide.
+std::uint64_t DecodeErrors();
+void RecordDecodeError();
+
+} // namespace compression
+#endif
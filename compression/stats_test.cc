@@ -0,0 +1,84 @@
+#include <string>
+#include <vector>
+#include "compression.h"
+#include "stats.h"
+#include "gtest/gtest.h"
+
+namespace compression {
+
+#ifndef COMPRESSION_DISABLE_STATS
+
+TEST(EncoderStats, CountsEncodingPaths) {
+  compression::Encoder encoder{};
+  encoder.Append(2 * 60 * 60 + 10, 1.0);
+  encoder.Append(2 * 60 * 60 + 20, 1.0);   // dod 0 (after the header delta of 10), zero xor
+  encoder.Append(2 * 60 * 60 + 60, 2.0);   // dod 30, new window
+  encoder.Append(2 * 60 * 60 + 400, 3.0);  // dod 300, new window
+  encoder.Append(2 * 60 * 60 + 740, 3.0);  // dod 0, zero xor
+  encoder.Append(2 * 60 * 60 + 5000, 2.0); // dod 3920, reuse window
+  encoder.Append(4 * 60 * 60 + 5, 2.0);    // new block
+
+  auto stats = encoder.Stats();
+  EXPECT_EQ(1U, stats.encoders);
+  EXPECT_EQ(2U, stats.blocks);
+  EXPECT_EQ(7U, stats.points);
+  EXPECT_EQ(2U, stats.ts_buckets[kTSBucketZero]);
+  EXPECT_EQ(1U, stats.ts_buckets[kTSBucket7Bits]);
+  EXPECT_EQ(0U, stats.ts_buckets[kTSBucket9Bits]);
+  EXPECT_EQ(1U, stats.ts_buckets[kTSBucket12Bits]);
+  EXPECT_EQ(1U, stats.ts_buckets[kTSBucket32Bits]);
+  EXPECT_EQ(2U, stats.val_paths[kValPathZeroXor]);
+  EXPECT_EQ(1U, stats.val_paths[kValPathReuseWindow]);
+  EXPECT_EQ(2U, stats.val_paths[kValPathNewWindow]);
+  // Only the last byte of every block may be partially used.
+  EXPECT_LE(encoder.SizeInBits(), stats.bytes * 8);
+  EXPECT_GT(encoder.SizeInBits() + 8 * stats.blocks, stats.bytes * 8);
+}
+
+TEST(EncoderStats, AggregatesAcrossEncoders) {
+  std::vector<Encoder> encoders(3);
+  for (int i = 0; i < 100; i++) {
+    for (auto& encoder : encoders) {
+      encoder.Append(2 * 60 * 60 + i * 10, i);
+    }
+  }
+  EncoderStats total;
+  for (auto& encoder : encoders) {
+    total += encoder.Stats();
+  }
+  EXPECT_EQ(3U, total.encoders);
+  EXPECT_EQ(3U, total.blocks);
+  EXPECT_EQ(300U, total.points);
+  EXPECT_EQ(3 * encoders[0].Stats().bytes, total.bytes);
+
+  auto text = total.ToText("tsdb");
+  EXPECT_NE(std::string::npos, text.find("tsdb_encoders 3\n"));
+  EXPECT_NE(std::string::npos, text.find("tsdb_points 300\n"));
+  EXPECT_NE(std::string::npos, text.find("tsdb_block_bytes_bucket{le=\"+Inf\"} 3\n"));
+  EXPECT_NE(std::string::npos, text.find("# TYPE tsdb_ts_bucket gauge\ntsdb_ts_bucket{bits=\"0\"} 294\n"));
+}
+
+TEST(EncoderStats, CountsDecodeErrors) {
+  std::vector<std::uint8_t> data = {0xFF};
+  DataIterator it(&data, 1, 0);
+  auto before = DecodeErrors();
+  EXPECT_THROW(*it, ParsingError);
+  EXPECT_EQ(before + 1, DecodeErrors());
+}
+
+#else
+
+TEST(EncoderStats, DisabledStatsLeaveOutPoints) {
+  compression::Encoder encoder{};
+  for (int i = 0; i < 100; i++) {
+    encoder.Append(2 * 60 * 60 + i * 10, i);
+  }
+  auto stats = encoder.Stats();
+  EXPECT_EQ(1U, stats.blocks);
+  EXPECT_EQ(0U, stats.points);
+  EXPECT_EQ(std::string::npos, stats.ToText("tsdb").find("tsdb_points"));
+}
+
+#endif // COMPRESSION_DISABLE_STATS
+
+} // namespace compression
@@ -0,0 +1,97 @@
+#include <functional>
+#include <queue>
+#include <utility>
+#include <vector>
+#include "store.h"
+
+namespace compression {
+
+SeriesStore::SeriesStore(const RetentionPolicy& per_series, std::uint64_t max_bytes):
+    per_series_(per_series), max_bytes_(max_bytes) {
+}
+
+void SeriesStore::Append(const std::string& series, TSType timestamp, ValType val) {
+    FindOrAdd(series).Append(timestamp, val);
+}
+
+Encoder& SeriesStore::FindOrAdd(const std::string& series) {
+    auto it = series_.find(series);
+    if (it == series_.end()) {
+        it = series_.emplace(series, Encoder(per_series_)).first;
+    }
+    return it->second;
+}
+
+Encoder* SeriesStore::Find(const std::string& series) {
+    auto it = series_.find(series);
+    return it == series_.end() ? nullptr : &it->second;
+}
+
+size_t SeriesStore::NumSeries() const {
+    return series_.size();
+}
+
+std::uint64_t SeriesStore::SizeInBytes() const {
+    std::uint64_t bytes = 0;
+    for (auto& pair : series_) {
+        bytes += pair.second.SizeInBytes();
+    }
+    return bytes;
+}
+
+size_t SeriesStore::EnforceRetention(TSType now) {
+    size_t evicted = 0;
+    if (per_series_.max_age_secs && now > per_series_.max_age_secs) {
+        TSType cutoff = now - per_series_.max_age_secs;
+        for (auto it = series_.begin(); it != series_.end();) {
+            TSType last_ts;
+            if (!it->second.LastTS(last_ts) || last_ts < cutoff) {
+                size_t blocks = it->second.NumBlocks();
+                evicted += blocks;
+                evicted_blocks_ += blocks + it->second.Stats().evicted_blocks;
+                it = series_.erase(it);
+                continue;
+            }
+            evicted += it->second.EvictBefore(cutoff);
+            ++it;
+        }
+    }
+
+    if (!max_bytes_) {
+        return evicted;
+    }
+    std::uint64_t bytes = SizeInBytes();
+    // Oldest evictable block across the series first.
+    using Candidate = std::pair<TSType, Encoder*>;
+    std::priority_queue<Candidate, std::vector<Candidate>, std::greater<Candidate>> oldest;
+    for (auto& pair : series_) {
+        TSType start_ts;
+        if (pair.second.OldestEvictable(start_ts)) {
+            oldest.push({start_ts, &pair.second});
+        }
+    }
+    while (bytes > max_bytes_ && !oldest.empty()) {
+        Encoder* encoder = oldest.top().second;
+        oldest.pop();
+        std::uint64_t before = encoder->SizeInBytes();
+        encoder->EvictOldest();
+        bytes -= before - encoder->SizeInBytes();
+        evicted++;
+        TSType start_ts;
+        if (encoder->OldestEvictable(start_ts)) {
+            oldest.push({start_ts, encoder});
+        }
+    }
+    return evicted;
+}
+
+EncoderStats SeriesStore::Stats() const {
+    EncoderStats stats;
+    stats.evicted_blocks = evicted_blocks_;
+    for (auto& pair : series_) {
+        stats += pair.second.Stats();
+    }
+    return stats;
+}
+
+} // namespace compression
@@ -0,0 +1,48 @@
+#ifndef COMPRESSION_STORE_H
+#define COMPRESSION_STORE_H
+
+#include <string>
+#include <unordered_map>
+#include <cinttypes>
+#include "common.h"
+#include "compression.h"
+#include "stats.h"
+
+namespace compression {
+
+// Encoders by series name under a common retention: the policy of every series and a byte
+// budget for all of them together.
+class SeriesStore {
+
+public:
+    // max_bytes caps the whole store, 0 means no limit.
+    explicit SeriesStore(const RetentionPolicy& per_series = RetentionPolicy(), std::uint64_t max_bytes = 0);
+
+    void Append(const std::string& series, TSType timestamp, ValType val);
+    // nullptr if there is no such series.
+    Encoder* Find(const std::string& series);
+    // The encoder of the series, added empty if there is none. It stays put until the series is
+    // dropped by EnforceRetention.
+    Encoder& FindOrAdd(const std::string& series);
+
+    size_t NumSeries() const;
+    std::uint64_t SizeInBytes() const;
+
+    // Drops the blocks more than max_age_secs older than now and the series without any newer
+    // point, then the oldest blocks across all the series until the store fits into max_bytes.
+    // Head blocks are only dropped with their series, so the budget can stay exceeded by them.
+    // Returns the number of blocks dropped.
+    size_t EnforceRetention(TSType now);
+
+    EncoderStats Stats() const;
+
+private:
+    RetentionPolicy per_series_;
+    std::uint64_t max_bytes_;
+    std::unordered_map<std::string, Encoder> series_;
+    // Blocks of the series dropped as a whole, the remaining ones are counted by their encoders.
+    std::uint64_t evicted_blocks_ = 0;
+};
+
+} // namespace compression
+#endif
@@ -0,0 +1,163 @@
+#include <utility>
+#include <vector>
+#include "streaming.h"
+
+namespace compression {
+
+namespace {
+
+// Blocks span two hours, anything bigger than this is a corrupted stream.
+const size_t kMaxBlockBytes = 1 << 24;
+
+const int kMaxVarintBytes = 10;
+
+void AppendVarint(std::vector<std::uint8_t>& out, std::uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back((value & 0x7F) | 0x80);
+        value >>= 7;
+    }
+    out.push_back(value);
+}
+
+// Returns the number of bytes read, or 0 if the varint isn't complete yet.
+size_t ReadVarint(const std::uint8_t* data, size_t size, std::uint64_t& value) {
+    value = 0;
+    for (size_t i = 0; i < size; i++) {
+        if (i == kMaxVarintBytes) {
+            ThrowParsingError("varint longer than " + std::to_string(kMaxVarintBytes) + " bytes");
+        }
+        value |= std::uint64_t(data[i] & 0x7F) << (7 * i);
+        if (!(data[i] & 0x80)) {
+            return i + 1;
+        }
+    }
+    return 0;
+}
+
+} // namespace
+
+void WriteDataRecord(const ByteSink& sink, const std::uint8_t* data, size_t size) {
+    std::vector<std::uint8_t> record;
+    record.reserve(1 + kMaxVarintBytes + size);
+    record.push_back(kRecordData);
+    AppendVarint(record, size);
+    record.insert(record.end(), data, data + size);
+    sink(record.data(), record.size());
+}
+
+void WriteEndRecord(const ByteSink& sink, StreamRecord type, const EncodedDataBlock& block) {
+    std::vector<std::uint8_t> record;
+    record.push_back(type);
+    std::uint64_t size_bits = block.SizeInBits();
+    AppendVarint(record, size_bits);
+    if (size_bits % 8) {
+        record.push_back(block.Bytes().back());
+    }
+    sink(record.data(), record.size());
+}
+
+StreamDecoder::StreamDecoder(PointSink on_point):
+    on_point_(std::move(on_point)),
+    decoded_bits_(0),
+    head_start_ts_(0) {
+}
+
+void StreamDecoder::Feed(const std::uint8_t* data, size_t size) {
+    pending_.insert(pending_.end(), data, data + size);
+    size_t offset = 0;
+    while (offset < pending_.size()) {
+        size_t record_size = HandleRecord(pending_.data() + offset, pending_.size() - offset);
+        if (!record_size) {
+            break;
+        }
+        offset += record_size;
+    }
+    pending_.erase(pending_.begin(), pending_.begin() + offset);
+}
+
+size_t StreamDecoder::HandleRecord(const std::uint8_t* data, size_t size) {
+    std::uint8_t type = data[0];
+    std::uint64_t value;
+    size_t varint_size = ReadVarint(data + 1, size - 1, value);
+    if (!varint_size) {
+        return 0;
+    }
+    size_t header_size = 1 + varint_size;
+
+    switch (type) {
+        case kRecordData: {
+            if (value > kMaxBlockBytes - head_.size()) {
+                ThrowParsingError("head block grows past " + std::to_string(kMaxBlockBytes) + " bytes");
+            }
+            if (size - header_size < value) {
+                return 0;
+            }
+            head_.insert(head_.end(), data + header_size, data + header_size + value);
+            return header_size + value;
+        }
+        case kRecordCommit:
+        case kRecordSeal: {
+            const std::uint8_t* last_byte = nullptr;
+            if (value % 8) {
+                if (size == header_size) {
+                    return 0;
+                }
+                last_byte = data + header_size;
+            }
+            if (type == kRecordCommit) {
+                DecodeHead(value, last_byte);
+            } else {
+                SealHead(value, last_byte);
+            }
+            return header_size + (last_byte ? 1 : 0);
+        }
+        default:
+            ThrowParsingError("unknown stream record type " + std::to_string(type));
+    }
+}
+
+void StreamDecoder::DecodeHead(std::uint64_t size_bits, const std::uint8_t* last_byte) {
+    if (head_.size() != size_bits / 8 || size_bits < decoded_bits_) {
+        ThrowParsingError("commit of " + std::to_string(size_bits) + " bits doesn't match the " +
+            std::to_string(head_.size()) + " bytes received");
+    }
+    // The partial byte only lives here until the data record completing it arrives.
+    if (last_byte) {
+        head_.push_back(*last_byte);
+    }
+    const std::uint8_t* data = head_.data();
+    std::uint64_t size = head_.size();
+    auto peek = [data, size](std::uint64_t pos) { return PeekBitsTail(data, size, pos); };
+    if (decoded_bits_ == 0) {
+        head_start_ts_ = ReadBlockHeaderChecked(peek, size_bits, head_state_);
+        decoded_bits_ = kBlockHeaderBits;
+        if (on_point_) {
+            on_point_(head_state_.ts, DoubleFromInt(head_state_.val));
+        }
+    }
+    while (decoded_bits_ < size_bits) {
+        decoded_bits_ = DecodePointChecked(peek, decoded_bits_, size_bits, head_start_ts_,
+            head_state_, COMPRESSION_COUNTERS(head_counters_));
+        if (on_point_) {
+            on_point_(head_state_.ts, DoubleFromInt(head_state_.val));
+        }
+    }
+    if (last_byte) {
+        head_.pop_back();
+    }
+}
+
+void StreamDecoder::SealHead(std::uint64_t size_bits, const std::uint8_t* last_byte) {
+    DecodeHead(size_bits, last_byte);
+    std::vector<std::uint8_t> bytes;
+    bytes.swap(head_);
+    if (last_byte) {
+        bytes.push_back(*last_byte);
+    }
+    replica_.AppendBlock(EncodedDataBlock::FromBytes(std::move(bytes), size_bits));
+    decoded_bits_ = 0;
+    head_state_ = StreamState();
+    COMPRESSION_STATS(head_counters_ = BlockCounters());
+}
+
+} // namespace compression
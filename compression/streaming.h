@@ -0,0 +1,71 @@
+#ifndef COMPRESSION_STREAMING_H
+#define COMPRESSION_STREAMING_H
+
+#include <functional>
+#include <vector>
+#include <cinttypes>
+#include "bit_reader.h"
+#include "common.h"
+#include "compression.h"
+#include "stats.h"
+
+namespace compression {
+
+// Replication stream, produced by Encoder::SetSink and consumed by StreamDecoder.
+//
+// It is a sequence of records, each starting with its type:
+//   kRecordData   varint length, bytes    - next completed bytes of the head block,
+//   kRecordCommit varint bits, last byte  - the head block so far, sent by Encoder::Flush,
+//   kRecordSeal   varint bits, last byte  - the head block is complete, the next data starts a new one.
+// The last byte is the partially filled one, only present if bits isn't a multiple of 8.
+// Varints are LEB128.
+enum StreamRecord : std::uint8_t {
+    kRecordData = 1,
+    kRecordCommit = 2,
+    kRecordSeal = 3,
+};
+
+void WriteDataRecord(const ByteSink& sink, const std::uint8_t* data, size_t size);
+// Writes a kRecordCommit or kRecordSeal for block.
+void WriteEndRecord(const ByteSink& sink, StreamRecord type, const EncodedDataBlock& block);
+
+// Follower side of the replication stream. Input can be split at any byte, the points are
+// handed to on_point as soon as a commit or seal makes them decodable and sealed blocks are
+// kept, as they were encoded, in Replica(). The stream is checked like EncodedDataBlock::Deserialize
+// does, anything inconsistent throws ParsingError and the decoder can't be used afterwards.
+class StreamDecoder {
+
+public:
+    using PointSink = std::function<void(TSType timestamp, ValType val)>;
+
+    explicit StreamDecoder(PointSink on_point = PointSink());
+
+    void Feed(const std::uint8_t* data, size_t size);
+
+    // Sealed blocks received so far.
+    Encoder& Replica() {
+        return replica_;
+    }
+
+private:
+    // Returns the size of the record at the start of data, or 0 if it isn't complete yet.
+    size_t HandleRecord(const std::uint8_t* data, size_t size);
+    void DecodeHead(std::uint64_t size_bits, const std::uint8_t* last_byte);
+    void SealHead(std::uint64_t size_bits, const std::uint8_t* last_byte);
+
+    PointSink on_point_;
+    Encoder replica_;
+
+    // Input which doesn't form a complete record yet.
+    std::vector<std::uint8_t> pending_;
+
+    // Completed bytes of the head block and how far it has been decoded, 0 before its header.
+    std::vector<std::uint8_t> head_;
+    std::uint64_t decoded_bits_;
+    TSType head_start_ts_;
+    StreamState head_state_;
+    COMPRESSION_STATS(BlockCounters head_counters_;)
+};
+
+} // namespace compression
+#endif
@@ -0,0 +1,118 @@
+#include <deque>
+#include <random>
+#include <utility>
+#include <vector>
+#include "compression.h"
+#include "streaming.h"
+#include "workloads.h"
+#include "gtest/gtest.h"
+
+namespace compression {
+
+// In-process pipe, whatever the leader writes comes out on the follower side in random chunks.
+class LoopbackPipe {
+
+public:
+  explicit LoopbackPipe(StreamDecoder* follower): follower_(follower), rng_(3) {}
+
+  ByteSink Sink() {
+    return [this](const std::uint8_t* data, size_t size) {
+      buffer_.insert(buffer_.end(), data, data + size);
+    };
+  }
+
+  // Delivers everything written so far, split at random points.
+  void Pump() {
+    while (!buffer_.empty()) {
+      size_t chunk = std::min<size_t>(1 + rng_() % 17, buffer_.size());
+      std::vector<std::uint8_t> data(buffer_.begin(), buffer_.begin() + chunk);
+      buffer_.erase(buffer_.begin(), buffer_.begin() + chunk);
+      follower_->Feed(data.data(), data.size());
+    }
+  }
+
+private:
+  StreamDecoder* follower_;
+  std::mt19937 rng_;
+  std::deque<std::uint8_t> buffer_;
+};
+
+TEST(Streaming, FollowerDecodesEveryPointAndReplicatesSealedBlocks) {
+  auto points = GenerateWorkload(Workload::kGaps, 20000);
+  std::vector<std::pair<TSType, ValType>> received;
+  StreamDecoder follower([&received](TSType ts, ValType val) { received.push_back({ts, val}); });
+  LoopbackPipe pipe(&follower);
+
+  compression::Encoder leader{};
+  leader.SetSink(pipe.Sink());
+  for (size_t i = 0; i < points.size(); i++) {
+    leader.Append(points[i].first, points[i].second);
+    if (i % 100 == 0) {
+      pipe.Pump();
+    }
+    if (i % 1000 == 0) {
+      leader.Flush();
+      pipe.Pump();
+      ASSERT_EQ(i + 1, received.size());
+    }
+  }
+  leader.Flush();
+  pipe.Pump();
+  EXPECT_EQ(points, received);
+
+  // Everything but the head block is in the replica, byte for byte.
+  auto replicated = follower.Replica().Decode();
+  ASSERT_LT(replicated.size(), points.size());
+  std::vector<std::pair<TSType, ValType>> sealed(points.begin(), points.begin() + replicated.size());
+  EXPECT_EQ(sealed, replicated);
+  EXPECT_EQ(leader.Stats().blocks - 1, follower.Replica().Stats().blocks);
+}
+
+TEST(Streaming, LateFollowerCatchesUp) {
+  auto points = GenerateWorkload(Workload::kJittered, 5000);
+  compression::Encoder leader{};
+  for (size_t i = 0; i < 3000; i++) {
+    leader.Append(points[i].first, points[i].second);
+  }
+
+  std::vector<std::pair<TSType, ValType>> received;
+  StreamDecoder follower([&received](TSType ts, ValType val) { received.push_back({ts, val}); });
+  LoopbackPipe pipe(&follower);
+  leader.SetSink(pipe.Sink());
+  for (size_t i = 3000; i < points.size(); i++) {
+    leader.Append(points[i].first, points[i].second);
+  }
+  leader.Flush();
+  pipe.Pump();
+  EXPECT_EQ(points, received);
+}
+
+TEST(Streaming, RejectsCorruptedStream) {
+  std::vector<std::uint8_t> stream;
+  compression::Encoder leader{};
+  leader.SetSink([&stream](const std::uint8_t* data, size_t size) {
+    stream.insert(stream.end(), data, data + size);
+  });
+  for (int i = 0; i < 10; i++) {
+    leader.Append(2 * 60 * 60 + i * 10, i);
+  }
+  leader.Flush();
+
+  StreamDecoder follower;
+  auto corrupted = stream;
+  corrupted[0] = 0x7F;
+  EXPECT_THROW(follower.Feed(corrupted.data(), corrupted.size()), ParsingError);
+
+  // A commit claiming more bits than were sent.
+  StreamDecoder other;
+  std::vector<std::uint8_t> commit = {kRecordCommit, 0x80, 0x01};
+  EXPECT_THROW(other.Feed(commit.data(), commit.size()), ParsingError);
+
+  // A data record whose size wraps around when added to the head block received so far.
+  StreamDecoder wrapping;
+  std::vector<std::uint8_t> data = {kRecordData, 0x01, 0xAA,
+      kRecordData, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x01};
+  EXPECT_THROW(wrapping.Feed(data.data(), data.size()), ParsingError);
+}
+
+} // namespace compression
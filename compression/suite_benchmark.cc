@@ -0,0 +1,96 @@
+#include <vector>
+#include <utility>
+
+#include "benchmark/benchmark.h"
+#include "compression.h"
+#include "workloads.h"
+
+// Benchmarks over the generated workloads, every one is run for each workload and series length.
+//
+// Reported counters:
+//   items_per_second - points encoded, decoded or returned per second,
+//   time_per_point   - the inverse, shown with an SI prefix (e.g. 25n is 25ns),
+//   bits_per_point   - compressed size of the series.
+
+namespace {
+
+const std::vector<int> kSeriesLengths = {1 << 8, 1 << 12, 1 << 16, 1 << 20};
+
+compression::Workload WorkloadArg(const benchmark::State& state) {
+    return compression::AllWorkloads()[state.range(0)];
+}
+
+void WorkloadsAndLengths(benchmark::internal::Benchmark* b) {
+    b->ArgNames({"workload", "points"});
+    for (size_t w = 0; w < compression::AllWorkloads().size(); w++) {
+        for (auto length : kSeriesLengths) {
+            b->Args({static_cast<long>(w), length});
+        }
+    }
+}
+
+void Encode(compression::Encoder& encoder, const std::vector<std::pair<compression::TSType, compression::ValType>>& points) {
+    for (auto& pair : points) {
+        encoder.Append(pair.first, pair.second);
+    }
+}
+
+void ReportCounters(benchmark::State& state, std::uint64_t points_per_iteration, double bits_per_point) {
+    state.SetLabel(compression::WorkloadName(WorkloadArg(state)));
+    state.SetItemsProcessed(state.iterations() * points_per_iteration);
+    state.counters["time_per_point"] = benchmark::Counter(points_per_iteration,
+        benchmark::Counter::kIsIterationInvariantRate | benchmark::Counter::kInvert);
+    state.counters["bits_per_point"] = bits_per_point;
+}
+
+} // namespace
+
+static void BM_Encode(benchmark::State& state) {
+    auto points = compression::GenerateWorkload(WorkloadArg(state), state.range(1));
+    double bits_per_point = 0;
+    for (auto _ : state) {
+        compression::Encoder encoder{};
+        Encode(encoder, points);
+        bits_per_point = static_cast<double>(encoder.SizeInBits()) / points.size();
+        benchmark::ClobberMemory();
+    }
+    ReportCounters(state, points.size(), bits_per_point);
+}
+BENCHMARK(BM_Encode)->Apply(WorkloadsAndLengths)->Unit(benchmark::kMicrosecond);
+
+static void BM_Decode(benchmark::State& state) {
+    auto points = compression::GenerateWorkload(WorkloadArg(state), state.range(1));
+    compression::Encoder encoder{};
+    Encode(encoder, points);
+    for (auto _ : state) {
+        std::uint64_t count = 0;
+        compression::ValType sum = 0;
+        for (auto pair : encoder) {
+            sum += pair.second;
+            count++;
+        }
+        benchmark::DoNotOptimize(sum);
+        benchmark::DoNotOptimize(count);
+    }
+    ReportCounters(state, points.size(), static_cast<double>(encoder.SizeInBits()) / points.size());
+}
+BENCHMARK(BM_Decode)->Apply(WorkloadsAndLengths)->Unit(benchmark::kMicrosecond);
+
+// Latency of reading the last tenth of the series, e.g. a dashboard showing the recent hours.
+static void BM_RangeQuery(benchmark::State& state) {
+    auto points = compression::GenerateWorkload(WorkloadArg(state), state.range(1));
+    compression::Encoder encoder{};
+    Encode(encoder, points);
+    auto from = points[points.size() - points.size() / 10 - 1].first;
+    auto to = points.back().first;
+    std::uint64_t returned = 0;
+    for (auto _ : state) {
+        auto range = encoder.DecodeRange(from, to);
+        returned = range.size();
+        benchmark::DoNotOptimize(range.data());
+    }
+    ReportCounters(state, returned, static_cast<double>(encoder.SizeInBits()) / points.size());
+}
+BENCHMARK(BM_RangeQuery)->Apply(WorkloadsAndLengths)->Unit(benchmark::kMicrosecond);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,185 @@
+#include <cerrno>
+#include <sstream>
+#include <system_error>
+#include <fcntl.h>
+#include <unistd.h>
+#include "tiering.h"
+
+namespace compression {
+
+namespace {
+
+[[noreturn]] void ThrowSystemError(const std::string& what) {
+    throw std::system_error(errno, std::generic_category(), what);
+}
+
+void WriteAll(int fd, const std::uint8_t* data, size_t size, std::uint64_t offset, const std::string& path) {
+    while (size > 0) {
+        ssize_t written = pwrite(fd, data, size, offset);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            ThrowSystemError("writing " + path);
+        }
+        data += written;
+        size -= written;
+        offset += written;
+    }
+}
+
+void ReadAll(int fd, std::uint8_t* data, size_t size, std::uint64_t offset) {
+    while (size > 0) {
+        ssize_t read = pread(fd, data, size, offset);
+        if (read < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            ThrowSystemError("reading a cold block");
+        }
+        if (read == 0) {
+            ThrowParsingError("cold block cut short by the end of its segment");
+        }
+        data += read;
+        size -= read;
+        offset += read;
+    }
+}
+
+} // namespace
+
+std::string ColdStorageStats::ToText(const std::string& prefix) const {
+    std::ostringstream out;
+    out << "# TYPE " << prefix << "_blocks gauge\n";
+    out << prefix << "_blocks " << blocks << "\n";
+    out << "# TYPE " << prefix << "_bytes gauge\n";
+    out << prefix << "_bytes " << bytes << "\n";
+    out << "# TYPE " << prefix << "_segments gauge\n";
+    out << prefix << "_segments " << segments << "\n";
+    out << "# TYPE " << prefix << "_cache_bytes gauge\n";
+    out << prefix << "_cache_bytes " << cache_bytes << "\n";
+    out << "# TYPE " << prefix << "_cache_requests_total counter\n";
+    out << prefix << "_cache_requests_total{result=\"hit\"} " << cache_hits << "\n";
+    out << prefix << "_cache_requests_total{result=\"miss\"} " << cache_misses << "\n";
+    return out.str();
+}
+
+ColdStorage::ColdStorage(const std::string& dir, std::uint64_t segment_bytes, std::uint64_t cache_bytes):
+    dir_(dir), segment_bytes_(segment_bytes), cache_bytes_(cache_bytes) {
+}
+
+ColdStorage::~ColdStorage() {
+    for (auto& pair : segments_) {
+        close(pair.second.fd);
+        unlink(pair.second.path.c_str());
+    }
+}
+
+void ColdStorage::StartSegment() {
+    std::uint64_t segment = next_segment_++;
+    std::string path = dir_ + "/segment-" + std::to_string(segment) + ".blocks";
+    int fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        ThrowSystemError("creating " + path);
+    }
+    // The previous segment is full, it goes away with its last block.
+    if (segments_.count(current_segment_) && !segments_[current_segment_].live_blocks) {
+        CloseSegment(current_segment_);
+    }
+    segments_[segment] = Segment{fd, path};
+    current_segment_ = segment;
+}
+
+void ColdStorage::CloseSegment(std::uint64_t segment) {
+    auto it = segments_.find(segment);
+    close(it->second.fd);
+    unlink(it->second.path.c_str());
+    segments_.erase(it);
+}
+
+std::uint64_t ColdStorage::Write(const EncodedDataBlock& block) {
+    auto frame = block.Serialize();
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!segments_.count(current_segment_) || segments_[current_segment_].size >= segment_bytes_) {
+        StartSegment();
+    }
+    Segment& segment = segments_[current_segment_];
+    WriteAll(segment.fd, frame.data(), frame.size(), segment.size, segment.path);
+
+    std::uint64_t id = next_id_++;
+    locations_[id] = Location{current_segment_, segment.size, frame.size()};
+    segment.size += frame.size();
+    segment.live_blocks++;
+    stats_.blocks++;
+    stats_.bytes += frame.size();
+    return id;
+}
+
+std::shared_ptr<EncodedDataBlock> ColdStorage::Read(std::uint64_t id) {
+    int fd;
+    Location location;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto cached = cached_.find(id);
+        if (cached != cached_.end()) {
+            cache_.splice(cache_.begin(), cache_, cached->second);
+            stats_.cache_hits++;
+            return cached->second->second;
+        }
+        stats_.cache_misses++;
+        location = locations_.at(id);
+        fd = segments_.at(location.segment).fd;
+    }
+
+    // The segment stays open while any of its blocks is alive, including the one being read.
+    std::vector<std::uint8_t> frame(location.size);
+    ReadAll(fd, frame.data(), frame.size(), location.offset);
+    std::shared_ptr<EncodedDataBlock> block(EncodedDataBlock::Deserialize(frame.data(), frame.size()));
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!cached_.count(id) && locations_.count(id)) {
+        cache_.emplace_front(id, block);
+        cached_[id] = cache_.begin();
+        stats_.cache_bytes += block->Bytes().size();
+        TrimCache();
+    }
+    return block;
+}
+
+void ColdStorage::TrimCache() {
+    while (stats_.cache_bytes > cache_bytes_ && !cache_.empty()) {
+        stats_.cache_bytes -= cache_.back().second->Bytes().size();
+        cached_.erase(cache_.back().first);
+        cache_.pop_back();
+    }
+}
+
+void ColdStorage::Release(std::uint64_t id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto location = locations_.find(id);
+    if (location == locations_.end()) {
+        return;
+    }
+    auto cached = cached_.find(id);
+    if (cached != cached_.end()) {
+        stats_.cache_bytes -= cached->second->second->Bytes().size();
+        cache_.erase(cached->second);
+        cached_.erase(cached);
+    }
+    stats_.blocks--;
+    stats_.bytes -= location->second.size;
+    std::uint64_t segment = location->second.segment;
+    locations_.erase(location);
+    if (!--segments_[segment].live_blocks && segment != current_segment_) {
+        CloseSegment(segment);
+    }
+}
+
+ColdStorageStats ColdStorage::Stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ColdStorageStats stats = stats_;
+    stats.segments = segments_.size();
+    return stats;
+}
+
+} // namespace compression
@@ -0,0 +1,91 @@
+#ifndef COMPRESSION_TIERING_H
+#define COMPRESSION_TIERING_H
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <cinttypes>
+#include "common.h"
+#include "compression.h"
+
+namespace compression {
+
+struct ColdStorageStats {
+    std::uint64_t blocks = 0;
+    std::uint64_t bytes = 0;
+    std::uint64_t segments = 0;
+    std::uint64_t cache_hits = 0;
+    std::uint64_t cache_misses = 0;
+    std::uint64_t cache_bytes = 0;
+
+    // Prometheus text exposition format, metric names start with prefix.
+    std::string ToText(const std::string& prefix = "compression_cold") const;
+};
+
+// Local disk tier for sealed blocks, see Encoder::SetColdStorage.
+//
+// Blocks are appended as Serialize frames to segment files in dir, a new segment is started
+// once the current one reaches segment_bytes. Reads go through pread and an LRU cache of
+// parsed blocks bounded by cache_bytes. A segment is deleted when all its blocks are released,
+// the rest are deleted with the storage. The files aren't synced, they are a cache for memory,
+// not a durable copy. Safe to use from several threads.
+class ColdStorage {
+
+public:
+    explicit ColdStorage(const std::string& dir, std::uint64_t segment_bytes = 64 << 20,
+        std::uint64_t cache_bytes = 64 << 20);
+    ~ColdStorage();
+    ColdStorage(const ColdStorage&) = delete;
+    ColdStorage& operator=(const ColdStorage&) = delete;
+
+    // Returns the id to read the block back with. Throws std::system_error on I/O errors.
+    std::uint64_t Write(const EncodedDataBlock& block);
+    // Throws std::system_error on I/O errors and ParsingError if the frame doesn't check out.
+    std::shared_ptr<EncodedDataBlock> Read(std::uint64_t id);
+    // The block won't be read anymore.
+    void Release(std::uint64_t id);
+
+    ColdStorageStats Stats() const;
+
+private:
+    struct Segment {
+        int fd;
+        std::string path;
+        std::uint64_t size = 0;
+        std::uint64_t live_blocks = 0;
+    };
+    struct Location {
+        std::uint64_t segment;
+        std::uint64_t offset;
+        std::uint64_t size;
+    };
+    using CacheList = std::list<std::pair<std::uint64_t, std::shared_ptr<EncodedDataBlock>>>;
+
+    void StartSegment();
+    void CloseSegment(std::uint64_t segment);
+    void TrimCache();
+
+    std::string dir_;
+    std::uint64_t segment_bytes_;
+    std::uint64_t cache_bytes_;
+
+    mutable std::mutex mutex_;
+    std::unordered_map<std::uint64_t, Segment> segments_;
+    std::uint64_t current_segment_ = 0;
+    std::uint64_t next_segment_ = 0;
+    std::unordered_map<std::uint64_t, Location> locations_;
+    std::uint64_t next_id_ = 0;
+
+    // Most recently used first.
+    CacheList cache_;
+    std::unordered_map<std::uint64_t, CacheList::iterator> cached_;
+
+    ColdStorageStats stats_;
+};
+
+} // namespace compression
+#endif
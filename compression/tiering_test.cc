@@ -0,0 +1,232 @@
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "archive.h"
+#include "batch_decoder.h"
+#include "compression.h"
+#include "tiering.h"
+#include "gtest/gtest.h"
+
+namespace compression {
+
+namespace {
+
+const TSType kStart = 1514764800;
+const TSType kHour = 60 * 60;
+
+void AppendHours(Encoder& encoder, TSType from, int hours) {
+  for (TSType ts = from; ts < from + hours * kHour; ts += 10) {
+    encoder.Append(ts, ts % 7 + 0.25 * (ts % 3));
+  }
+}
+
+bool Exists(const std::string& path) {
+  struct stat st;
+  return stat(path.c_str(), &st) == 0;
+}
+
+} // namespace
+
+class Tiering : public ::testing::Test {
+protected:
+  void SetUp() override {
+    const char* base = std::getenv("TEST_TMPDIR");
+    dir_ = std::string(base ? base : "/tmp") + "/tiering_test.XXXXXX";
+    ASSERT_NE(nullptr, mkdtemp(&dir_[0]));
+  }
+
+  // The storage is gone by now, and so should be its segments.
+  void TearDown() override {
+    EXPECT_EQ(0, rmdir(dir_.c_str()));
+  }
+
+  std::string dir_;
+};
+
+TEST_F(Tiering, ColdBlocksDecodeTheSame) {
+  ColdStorage storage(dir_);
+  Encoder unlimited;
+  Encoder encoder;
+  encoder.SetColdStorage(&storage, 4 * kHour);
+  AppendHours(unlimited, kStart, 24);
+  AppendHours(encoder, kStart, 24);
+
+  // Blocks move out as new ones start, those with a point within the last 4h by then stay.
+  EXPECT_EQ(unlimited.NumBlocks(), encoder.NumBlocks());
+  EXPECT_EQ(unlimited.SizeInBytes(), encoder.SizeInBytes());
+  EXPECT_LT(encoder.ResidentBytes() * 3, encoder.SizeInBytes());
+  EXPECT_EQ(9U, storage.Stats().blocks);
+
+  EXPECT_EQ(unlimited.Decode(), encoder.Decode());
+  EXPECT_EQ(unlimited.DecodeBlock(1), encoder.DecodeBlock(1));
+  EXPECT_EQ(unlimited.DecodeRange(kStart + kHour, kStart + 5 * kHour),
+            encoder.DecodeRange(kStart + kHour, kStart + 5 * kHour));
+  std::vector<std::pair<TSType, ValType>> iterated(encoder.begin(), encoder.end());
+  EXPECT_EQ(unlimited.Decode(), iterated);
+  EXPECT_EQ(unlimited.Stats().bytes, encoder.Stats().bytes);
+}
+
+TEST_F(Tiering, CacheCountsHitsAndStaysBounded) {
+  Encoder sizing;
+  AppendHours(sizing, kStart, 2);
+  std::uint64_t block_bytes = sizing.SizeInBytes();
+
+  // Room for two cached blocks.
+  ColdStorage storage(dir_, 64 << 20, 2 * block_bytes + block_bytes / 2);
+  Encoder encoder;
+  encoder.SetColdStorage(&storage, kHour);
+  AppendHours(encoder, kStart, 12);
+  ASSERT_EQ(4U, storage.Stats().blocks);
+
+  encoder.DecodeBlock(0);
+  encoder.DecodeBlock(0);
+  auto stats = storage.Stats();
+  EXPECT_EQ(1U, stats.cache_misses);
+  EXPECT_EQ(1U, stats.cache_hits);
+
+  // Going through the other cold blocks pushes block 0 out of the cache.
+  for (size_t i = 1; i < 4; i++) {
+    encoder.DecodeBlock(i);
+  }
+  encoder.DecodeBlock(0);
+  stats = storage.Stats();
+  EXPECT_EQ(5U, stats.cache_misses);
+  EXPECT_EQ(1U, stats.cache_hits);
+  EXPECT_LE(stats.cache_bytes, 2 * block_bytes + block_bytes / 2);
+  EXPECT_GT(stats.cache_bytes, 0U);
+  EXPECT_NE(std::string::npos,
+            stats.ToText().find("compression_cold_cache_requests_total{result=\"hit\"} 1\n"));
+}
+
+TEST_F(Tiering, SegmentsGoAwayWithTheirBlocks) {
+  // A block per segment.
+  ColdStorage storage(dir_, 1);
+  RetentionPolicy retention;
+  retention.max_age_secs = 6 * kHour;
+  Encoder encoder(retention);
+  encoder.SetColdStorage(&storage, kHour);
+  AppendHours(encoder, kStart, 24);
+
+  // Blocks 8 and 9 are cold, retention released the older ones and their segments.
+  ASSERT_EQ(4U, encoder.NumBlocks());
+  auto stats = storage.Stats();
+  EXPECT_EQ(2U, stats.blocks);
+  EXPECT_EQ(2U, stats.segments);
+  EXPECT_FALSE(Exists(dir_ + "/segment-0.blocks"));
+  EXPECT_FALSE(Exists(dir_ + "/segment-7.blocks"));
+  EXPECT_TRUE(Exists(dir_ + "/segment-9.blocks"));
+}
+
+TEST_F(Tiering, DecodeRangeWithoutCache) {
+  // Loaded blocks are only kept alive by the decoder itself.
+  ColdStorage storage(dir_, 1 << 20, 0);
+  Encoder unlimited;
+  Encoder encoder;
+  encoder.SetColdStorage(&storage, kHour);
+  AppendHours(unlimited, kStart, 12);
+  AppendHours(encoder, kStart, 12);
+  ASSERT_GT(storage.Stats().blocks, 0U);
+  EXPECT_EQ(unlimited.DecodeRange(kStart + 2 * kHour, kStart + 8 * kHour),
+            encoder.DecodeRange(kStart + 2 * kHour, kStart + 8 * kHour));
+  EXPECT_EQ(unlimited.Decode(), encoder.Decode());
+  EXPECT_EQ(0U, storage.Stats().cache_bytes);
+}
+
+TEST_F(Tiering, CorruptSegmentFailsToParse) {
+  ColdStorage storage(dir_);
+  Encoder encoder;
+  encoder.SetColdStorage(&storage, kHour);
+  AppendHours(encoder, kStart, 8);
+  ASSERT_EQ(2U, storage.Stats().blocks);
+
+  FILE* segment = fopen((dir_ + "/segment-0.blocks").c_str(), "r+b");
+  ASSERT_NE(nullptr, segment);
+  fseek(segment, 20, SEEK_SET);
+  fputc(0x5a, segment);
+  fclose(segment);
+  EXPECT_THROW(encoder.DecodeBlock(0), ParsingError);
+  // The other block and the head are fine.
+  EXPECT_FALSE(encoder.DecodeBlock(1).empty());
+  EXPECT_FALSE(encoder.DecodeBlock(3).empty());
+}
+
+TEST_F(Tiering, HotWindowLongerThanTheTimestamps) {
+  // The cutoff would be before the epoch, every block is still hot.
+  ColdStorage storage(dir_);
+  Encoder encoder;
+  encoder.SetColdStorage(&storage, 4 * kHour);
+  AppendHours(encoder, 0, 4);
+  EXPECT_EQ(2U, encoder.NumBlocks());
+  EXPECT_EQ(0U, storage.Stats().blocks);
+  EXPECT_EQ(encoder.SizeInBytes(), encoder.ResidentBytes());
+}
+
+TEST_F(Tiering, ColdBlockNeedsLoad) {
+  ColdStorage storage(dir_);
+  EncodedDataBlock block(kStart, 1);
+  block.Append(kStart + 10, 2);
+  auto points = block.Decode();
+  std::uint64_t bits = block.SizeInBits();
+
+  block.MoveToColdStorage(storage);
+  EXPECT_TRUE(block.IsCold());
+  EXPECT_TRUE(block.Bytes().empty());
+  EXPECT_EQ(bits, block.SizeInBits());
+  EXPECT_THROW(block.Decode(), std::logic_error);
+  EXPECT_EQ(points, block.Load()->Decode());
+}
+
+TEST_F(Tiering, BatchDecoderLoadsColdBlocks) {
+  ColdStorage storage(dir_);
+  std::vector<std::unique_ptr<EncodedDataBlock>> blocks;
+  std::vector<std::vector<std::pair<TSType, ValType>>> expected;
+  for (int b = 0; b < 3; b++) {
+    TSType start = kStart + b * 2 * kHour;
+    blocks.emplace_back(new EncodedDataBlock(start, b));
+    for (TSType ts = start + 10; ts < start + kHour; ts += 10) {
+      blocks.back()->Append(ts, ts % 7 + 0.25 * b);
+    }
+    expected.push_back(blocks.back()->Decode());
+  }
+  blocks[0]->MoveToColdStorage(storage);
+  blocks[2]->MoveToColdStorage(storage);
+
+  std::vector<EncodedDataBlock*> input;
+  for (auto& block : blocks) {
+    input.push_back(block.get());
+  }
+  EXPECT_EQ(expected, BatchDecoder(BatchKernel::kScalar).Decode(input));
+  if (BatchDecoder::AVX2Supported()) {
+    EXPECT_EQ(expected, BatchDecoder(BatchKernel::kAVX2).Decode(input));
+  }
+}
+
+TEST_F(Tiering, ArchiveLoadsColdBlocks) {
+  ColdStorage storage(dir_);
+  std::vector<std::unique_ptr<EncodedDataBlock>> blocks;
+  std::vector<const EncodedDataBlock*> input;
+  for (int b = 0; b < 4; b++) {
+    TSType start = kStart + b * 2 * kHour;
+    blocks.emplace_back(new EncodedDataBlock(start, b));
+    for (TSType ts = start + 10; ts < start + 2 * kHour; ts += 10) {
+      blocks.back()->Append(ts, ts % 7);
+    }
+    input.push_back(blocks.back().get());
+  }
+  auto dictionary = TrainDictionary(input, 1 << 10);
+  auto archive = ArchiveBlocks(input, &dictionary);
+
+  for (auto& block : blocks) {
+    block->MoveToColdStorage(storage);
+  }
+  auto cold_dictionary = TrainDictionary(input, 1 << 10);
+  EXPECT_EQ(dictionary.id, cold_dictionary.id);
+  EXPECT_EQ(dictionary.bytes, cold_dictionary.bytes);
+  EXPECT_EQ(archive, ArchiveBlocks(input, &cold_dictionary));
+}
+
+} // namespace compression
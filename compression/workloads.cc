@@ -0,0 +1,122 @@
+#include <cmath>
+#include <random>
+#include "workloads.h"
+
+namespace compression {
+
+namespace {
+
+// Somewhere in 2018, aligned to the block size.
+const TSType kStartTS = 1514764800;
+
+} // namespace
+
+const std::vector<Workload>& AllWorkloads() {
+    static const std::vector<Workload> workloads = {
+        Workload::kRegular,
+        Workload::kJittered,
+        Workload::kRandomWalkGauge,
+        Workload::kMonotonicCounter,
+        Workload::kConstant,
+        Workload::kNoisyFloat,
+        Workload::kGaps,
+        Workload::kOutages,
+    };
+    return workloads;
+}
+
+std::string WorkloadName(Workload workload) {
+    switch (workload) {
+        case Workload::kRegular:
+            return "regular";
+        case Workload::kJittered:
+            return "jittered";
+        case Workload::kRandomWalkGauge:
+            return "random_walk_gauge";
+        case Workload::kMonotonicCounter:
+            return "monotonic_counter";
+        case Workload::kConstant:
+            return "constant";
+        case Workload::kNoisyFloat:
+            return "noisy_float";
+        case Workload::kGaps:
+            return "gaps";
+        case Workload::kOutages:
+            return "outages";
+    }
+    return "unknown";
+}
+
+std::vector<std::pair<TSType, ValType>> GenerateWorkload(
+    Workload workload, int num_points, std::uint64_t seed) {
+    std::mt19937_64 rng(seed);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    std::normal_distribution<double> normal(0.0, 1.0);
+
+    std::vector<std::pair<TSType, ValType>> points;
+    points.reserve(num_points);
+    TSType ts = kStartTS;
+    ValType val = 0;
+    for (int i = 0; i < num_points; i++) {
+        switch (workload) {
+            case Workload::kRegular:
+                ts = kStartTS + i * 10;
+                val = i + 0.3;
+                break;
+            case Workload::kJittered: {
+                // Mostly within a second, sometimes a scrape is late by up to a few minutes.
+                int step = 10 + static_cast<int>(normal(rng) * 0.5);
+                if (uniform(rng) < 0.01) {
+                    step += static_cast<int>(uniform(rng) * 300);
+                }
+                if (i) {
+                    ts += step > 1 ? step : 1;
+                }
+                val = 50 + 10 * std::sin(i / 100.0);
+                break;
+            }
+            case Workload::kRandomWalkGauge:
+                ts = kStartTS + i * 15;
+                val += normal(rng);
+                break;
+            case Workload::kMonotonicCounter:
+                ts = kStartTS + i * 10;
+                val += static_cast<int>(uniform(rng) * 1000);
+                break;
+            case Workload::kConstant:
+                ts = kStartTS + i * 60;
+                val = 1;
+                break;
+            case Workload::kNoisyFloat:
+                ts = kStartTS + i * 10;
+                val = normal(rng) * 1000;
+                break;
+            case Workload::kGaps:
+                if (i) {
+                    ts += 10;
+                    double r = uniform(rng);
+                    if (r < 0.001) {
+                        // Outage longer than a block.
+                        ts += 3 * 60 * 60 + static_cast<TSType>(uniform(rng) * 3600);
+                    } else if (r < 0.02) {
+                        ts += 10 * static_cast<TSType>(1 + uniform(rng) * 30);
+                    }
+                }
+                val = 0.5 + (i % 100) * 0.01;
+                break;
+            case Workload::kOutages:
+                if (i) {
+                    ts += 10;
+                    if (uniform(rng) < 0.002) {
+                        ts += 2100 + static_cast<TSType>(uniform(rng) * 3300);
+                    }
+                }
+                val = 0.5 + (i % 100) * 0.01;
+                break;
+        }
+        points.push_back({ts, val});
+    }
+    return points;
+}
+
+} // namespace compression
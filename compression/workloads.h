@@ -0,0 +1,41 @@
+#ifndef COMPRESSION_WORKLOADS_H
+#define COMPRESSION_WORKLOADS_H
+
+#include <string>
+#include <utility>
+#include <vector>
+#include <cinttypes>
+#include "common.h"
+
+namespace compression {
+
+// Synthetic series shaped like the metrics we store, used by benchmarks and tests.
+enum class Workload {
+    // Perfectly regular 10s interval, slowly increasing value.
+    kRegular,
+    // 10s interval with scrape jitter and occasional late samples.
+    kJittered,
+    // Gauge doing a random walk, e.g. memory usage or temperature.
+    kRandomWalkGauge,
+    // Integer counter increasing at a varying rate, e.g. requests served.
+    kMonotonicCounter,
+    // Value that never changes.
+    kConstant,
+    // Independent random floats, the worst case for XOR encoding.
+    kNoisyFloat,
+    // Regular series with missing scrapes and multi-hour outages.
+    kGaps,
+    // Regular series with outages of 35 min to 1.5h, which mostly stay inside a block and
+    // need the widest delta of delta bucket.
+    kOutages,
+};
+
+const std::vector<Workload>& AllWorkloads();
+std::string WorkloadName(Workload workload);
+
+// Deterministic for a given seed, timestamps never decrease.
+std::vector<std::pair<TSType, ValType>> GenerateWorkload(
+    Workload workload, int num_points, std::uint64_t seed = 1);
+
+} // namespace compression
+#endif